@@ -0,0 +1,176 @@
+#include "cachebench.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <SDL2/SDL.h>
+#include "camera.h"
+#include "ellipsoid.h"
+#include "log.h"
+#include "player.h"
+#include "prng.h"
+
+#define CACHE_LINE_SIZE 64
+#define N_ELLIPSOIDS 300
+
+// Set associative cache with least recently used replacement
+struct Cache {
+	const char *name;
+	int nsets, nways;
+	uint64_t *tags;        // nsets*nways, 0 means empty
+	uint64_t *lastused;    // nsets*nways
+	uint64_t time;
+	long misses;
+};
+
+static struct Cache create_cache(const char *name, int size, int nways)
+{
+	struct Cache c = { .name = name, .nways = nways, .nsets = size / (CACHE_LINE_SIZE*nways) };
+	c.tags = calloc((size_t)(c.nsets*nways), sizeof(c.tags[0]));
+	c.lastused = calloc((size_t)(c.nsets*nways), sizeof(c.lastused[0]));
+	if (!c.tags || !c.lastused)
+		log_printf_abort("not enough memory for simulated cache");
+	return c;
+}
+
+static void access_memory(struct Cache *c, uint64_t address)
+{
+	uint64_t line = address / CACHE_LINE_SIZE + 1;   // +1 because 0 means empty
+	int set = (int)(line % (uint64_t)c->nsets);
+	uint64_t *tags = &c->tags[set*c->nways];
+	uint64_t *lastused = &c->lastused[set*c->nways];
+	c->time++;
+
+	int oldest = 0;
+	for (int w = 0; w < c->nways; w++) {
+		if (tags[w] == line) {
+			lastused[w] = c->time;
+			return;
+		}
+		if (lastused[w] < lastused[oldest])
+			oldest = w;
+	}
+	c->misses++;
+	tags[oldest] = line;
+	lastused[oldest] = c->time;
+}
+
+// Converts an index of the brick layout to what it would be in the [x][y][z] layout
+static int brick_to_plain(int idx)
+{
+	int brickstart = 0, plainstart = 0;
+	int level = 0;
+	while (idx >= brickstart + ELLIPSOIDPIC_LEVEL_SIZE(level)) {
+		int side = ELLIPSOIDPIC_LEVEL_SIDE(level);
+		brickstart += ELLIPSOIDPIC_LEVEL_SIZE(level);
+		plainstart += side*side*side;
+		level++;
+	}
+
+	int side = ELLIPSOIDPIC_LEVEL_SIDE(level);
+	int nbricks = ELLIPSOIDPIC_LEVEL_NBRICKS(level);
+	int brick = (idx - brickstart) / 64;
+	int inbrick = (idx - brickstart) % 64;
+	int x = 4*(brick / (nbricks*nbricks)) + (inbrick >> 4);
+	int y = 4*(brick / nbricks % nbricks) + ((inbrick >> 2) & 3);
+	int z = 4*(brick % nbricks) + (inbrick & 3);
+	SDL_assert(ellipsoidpic_index(nbricks, x, y, z) == idx - brickstart);
+	return plainstart + (x*side + y)*side + z;
+}
+
+static void run_benchmark(SDL_Surface *surf, const struct Ellipsoid *els, bool usemips)
+{
+	struct Camera cam = {
+		.surface = surf,
+		.screencentery = (float)surf->h/4,   // like when playing
+		.location = { 0, 4, 0 },
+	};
+	camera_update_caches(&cam);
+
+	// typical sizes of L1 and L2 caches
+	struct Cache caches[2][2];
+	for (int layout = 0; layout < 2; layout++) {
+		caches[layout][0] = create_cache("L1 (32K)", 32*1024, 8);
+		caches[layout][1] = create_cache("L2 (1M)", 1024*1024, 16);
+	}
+
+	long npixels = 0;
+	for (int i = 0; i < N_ELLIPSOIDS; i++) {
+		if (!ellipsoid_is_visible(&els[i], &cam))
+			continue;
+		int level = usemips ? ellipsoid_choose_miplevel(ellipsoid_bbox_unclipped(&els[i], &cam), cam.lodbias) : 0;
+
+		for (int y = 0; y < surf->h; y++) {
+			int xmin, xmax;
+			if (!ellipsoid_xminmax(&els[i], &cam, y, &xmin, &xmax))
+				continue;
+			ellipsoid_drawrow(&els[i], &cam, level, y, xmin, xmax);
+
+			const uint32_t *row = (const uint32_t *)surf->pixels + y*surf->pitch/4;
+			for (int x = xmin; x < xmax; x++) {
+				int idx = (int)row[x];
+				for (int c = 0; c < 2; c++) {
+					access_memory(&caches[0][c], 4*(uint64_t)idx);
+					access_memory(&caches[1][c], 4*(uint64_t)brick_to_plain(idx));
+				}
+				npixels++;
+			}
+		}
+	}
+
+	printf("%s, %ld pixels drawn\n", usemips ? "With mip levels" : "Without mip levels", npixels);
+	for (int c = 0; c < 2; c++) {
+		printf("  %-10s cache misses per pixel: [x][y][z] %.4f, 4x4x4 bricks %.4f\n",
+			caches[0][c].name,
+			(double)caches[1][c].misses / (double)npixels,
+			(double)caches[0][c].misses / (double)npixels);
+	}
+
+	for (int layout = 0; layout < 2; layout++) {
+		for (int c = 0; c < 2; c++) {
+			free(caches[layout][c].tags);
+			free(caches[layout][c].lastused);
+		}
+	}
+}
+
+void cachebench_run(void)
+{
+	SDL_Surface *surf = SDL_CreateRGBSurfaceWithFormat(
+		0, CAMERA_SCREEN_WIDTH/2, CAMERA_SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_RGB888);
+	if (!surf)
+		log_printf_abort("SDL_CreateRGBSurfaceWithFormat failed: %s", SDL_GetError());
+
+	struct EllipsoidPic *epic = malloc(sizeof(*epic));
+	if (!epic)
+		log_printf_abort("not enough memory for ellipsoid pic");
+	epic->path[0] = '\0';
+	epic->pixfmt = surf->format;
+	for (int hl = 0; hl < 2; hl++) {
+		for (int i = 0; i < ELLIPSOIDPIC_TOTAL_SIZE; i++)
+			epic->cubepixels[hl][i] = (uint32_t)i;
+	}
+
+	// Players in front of the camera, at different distances and angles
+	struct Prng prng;
+	prng_seed(&prng, 123);
+	static struct Ellipsoid els[N_ELLIPSOIDS];
+	for (int i = 0; i < N_ELLIPSOIDS; i++) {
+		float dist = 2 + 25*prng_float(&prng);
+		els[i] = (struct Ellipsoid){
+			.center = { 0, PLAYER_YRADIUS_NOFLAT, -dist },
+			.epic = epic,
+			.xzradius = PLAYER_XZRADIUS,
+			.yradius = PLAYER_YRADIUS_NOFLAT,
+		};
+		els[i].center.x = dist*(prng_float(&prng) - 0.5f);
+		els[i].angle = 7*prng_float(&prng);
+		ellipsoid_update_transforms(&els[i]);
+	}
+
+	run_benchmark(surf, els, false);
+	run_benchmark(surf, els, true);
+
+	free(epic);
+	SDL_FreeSurface(surf);
+}
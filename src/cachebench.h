@@ -0,0 +1,19 @@
+/*
+How well does drawing ellipsoids use the CPU cache? This compares the 4x4x4
+brick layout of EllipsoidPic (see ellipsoid.h) with the plain [x][y][z] layout.
+
+Hardware cache miss counters aren't available on all platforms, so this draws
+ellipsoids of player size as seen from a player's camera, and feeds the
+memory accesses to a simulated cache. Colors don't affect which pixels of
+the cube get accessed, so instead of a player picture, each pixel of the cube
+contains its own index. That way, drawing tells us exactly which places of the
+cube were used.
+*/
+
+#ifndef CACHEBENCH_H
+#define CACHEBENCH_H
+
+// Prints results to stdout
+void cachebench_run(void);
+
+#endif   // CACHEBENCH_H
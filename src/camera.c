@@ -1,5 +1,6 @@
 #include "camera.h"
 #include <assert.h>
+#include <math.h>
 #include <string.h>
 #include <SDL2/SDL.h>
 #include "linalg.h"
@@ -17,8 +18,13 @@ void camera_update_caches(struct Camera *cam)
 {
 	cam->cam2world = mat3_rotation_xz(cam->angle);
 	cam->world2cam = mat3_rotation_xz(-cam->angle);
+	cam->scaling = CAMERA_SCALING_FACTOR * (cam->resolution > 0 ? cam->resolution : 1);
 
-	// see also CAMERA_CAMPLANE_IDX
+	// Without a window, there's nothing to show, so visplanes aren't needed
+	if (!cam->surface)
+		return;
+
+	// see also CAMERA_CAMPLANE_IDX and CAMERA_FARPLANE_IDX
 	struct Plane pl[] = {
 		// z=0, with normal vector to negative side (that's where camera is looking)
 		{ .normal = {0, 0, -1}, .constant = 0 },
@@ -34,6 +40,9 @@ void camera_update_caches(struct Camera *cam)
 
 		// bottom, normal vector to positive y direction
 		{ .normal = {0, 1, -camera_screeny_to_yzr(cam, (float)cam->surface->h)}, .constant = 0 },
+
+		// z=-drawdistance, normal vector towards camera
+		{ .normal = {0, 0, 1}, .constant = cam->drawdistance > 0 ? -cam->drawdistance : -HUGE_VALF },
 	};
 
 	// Convert from camera coordinates to world coordinates
@@ -4,10 +4,17 @@
 #include <SDL2/SDL.h>
 #include "linalg.h"
 
-// surfaces can be smaller than this, but these are handy for array sizes
+// default window size, can be changed with --size
 #define CAMERA_SCREEN_WIDTH 800
 #define CAMERA_SCREEN_HEIGHT 600
 
+/*
+Functions that draw a row of pixels do it in strips of this many pixels. This
+way temporary arrays are small enough to stay in L1 cache, and any surface
+width works.
+*/
+#define CAMERA_STRIP_WIDTH 64
+
 #define CAMERA_FPS 60
 
 /*
@@ -25,8 +32,12 @@ struct Camera {
 	// call camera_update_caches() after changing these
 	Vec3 location;
 	float angle;  // 0 means camera looks towards negative z axis
+	float drawdistance;   // things further than this aren't shown, 0 means no limit
+	float resolution;   // surface pixels per window pixel, e.g. 0.5 when drawing at half size, 0 means 1
+	int lodbias;   // n means smaller mipmaps and impostors, as if ellipsoids were 2^n times smaller on screen
 
 	Mat3 world2cam, cam2world;
+	float scaling;   // pixels per unit of xzr or yzr, depends on resolution
 
 	/*
 	For checking whether an object is visible or not, we split the world
@@ -34,7 +45,7 @@ struct Camera {
 	visibility plane points to the visible side. So, for a point to be
 	visible, plane_whichside() must return true for each visibility plane.
 	*/
-	struct Plane visplanes[5];
+	struct Plane visplanes[6];
 };
 
 /*
@@ -43,6 +54,12 @@ to object not being behind camera
 */
 #define CAMERA_CAMPLANE_IDX 0
 
+/*
+visplanes[CAMERA_FARPLANE_IDX] is at distance cam->drawdistance in front of
+the camera. Without a draw distance, it's infinitely far away.
+*/
+#define CAMERA_FARPLANE_IDX 5
+
 /*
 The conversion between these consists of a rotation about the camera location and
 offsetting by the camera location vector. This is what these functions do, but
@@ -70,14 +87,13 @@ Hints for figuring out the formulas:
 - More x means right, which means means more screen x. More y means up, which
   means *less* screen y. That's how coordinates work in most 2D graphics things.
 */
-#define SCALING_FACTOR 300.f
-inline float camera_xzr_to_screenx(const struct Camera *cam, float xzr) { return (float)cam->surface->w/2 - SCALING_FACTOR*xzr; }
-inline float camera_yzr_to_screeny(const struct Camera *cam, float yzr) { return cam->screencentery + SCALING_FACTOR*yzr; }
-inline float camera_screenx_to_xzr(const struct Camera *cam, float screenx) { return (-screenx + (float)cam->surface->w/2)/SCALING_FACTOR; }
-inline float camera_screeny_to_yzr(const struct Camera *cam, float screeny) { return (screeny - cam->screencentery)/SCALING_FACTOR; }
-#undef SCALING_FACTOR
-
-// call this after changing cam->location or cam->world2cam
+#define CAMERA_SCALING_FACTOR 300.f   // at full resolution
+inline float camera_xzr_to_screenx(const struct Camera *cam, float xzr) { return (float)cam->surface->w/2 - cam->scaling*xzr; }
+inline float camera_yzr_to_screeny(const struct Camera *cam, float yzr) { return cam->screencentery + cam->scaling*yzr; }
+inline float camera_screenx_to_xzr(const struct Camera *cam, float screenx) { return (-screenx + (float)cam->surface->w/2)/cam->scaling; }
+inline float camera_screeny_to_yzr(const struct Camera *cam, float screeny) { return (screeny - cam->screencentery)/cam->scaling; }
+
+// call this after changing cam->location, cam->angle, cam->drawdistance or cam->resolution
 void camera_update_caches(struct Camera *cam);
 
 inline Vec2 camera_point_cam2screen(const struct Camera *cam, Vec3 pt)
@@ -18,7 +18,7 @@
 
 #define FONT_SIZE 40
 
-#define PLAYER_CHOOSER_HEIGHT ( CAMERA_SCREEN_HEIGHT/2 )
+#define PLAYER_CHOOSER_HEIGHT(WinSurf) ( (WinSurf)->h/2 )
 
 #define ELLIPSOID_XZ_DISTANCE_FROM_ORIGIN 2.0f
 #define CAMERA_XZ_DISTANCE_FROM_ORIGIN 5.0f
@@ -31,8 +31,8 @@ static void update_player_name_display(struct ChooserPlayerStuff *plrch)
 	SDL_assert(plrch->prevbtn.destsurf == plrch->nextbtn.destsurf);
 	SDL_Surface *winsurf = plrch->nextbtn.destsurf;
 	SDL_Point center = {
-		plrch->leftx + CAMERA_SCREEN_WIDTH/4,
-		PLAYER_CHOOSER_HEIGHT - FONT_SIZE/2 - 5,  // -5 because apparently text can go below bottom
+		plrch->leftx + winsurf->w/4,
+		PLAYER_CHOOSER_HEIGHT(winsurf) - FONT_SIZE/2 - 5,  // -5 because apparently text can go below bottom
 	};
 
 	if (plrch->namew != 0 && plrch->nameh != 0) {
@@ -84,8 +84,8 @@ static void setup_player_chooser(struct Chooser *ch, int idx, int scprev, int sc
 
 	enum ButtonFlags flags = BUTTON_VERTICAL | BUTTON_SMALL;
 	SDL_Rect preview = {
-		.w = CAMERA_SCREEN_WIDTH/2 - 2*button_width(flags),
-		.h = PLAYER_CHOOSER_HEIGHT - 2*FONT_SIZE,
+		.w = ch->winsurf->w/2 - 2*button_width(flags),
+		.h = PLAYER_CHOOSER_HEIGHT(ch->winsurf) - 2*FONT_SIZE,
 		.x = leftx + button_width(flags),
 		.y = FONT_SIZE,
 	};
@@ -100,7 +100,7 @@ static void setup_player_chooser(struct Chooser *ch, int idx, int scprev, int sc
 			.imgpath = "assets/resized/arrows/left.png",
 			.scancodes = {scprev},
 			.destsurf = ch->winsurf,
-			.center = { leftx + button_width(flags)/2, PLAYER_CHOOSER_HEIGHT/2 },
+			.center = { leftx + button_width(flags)/2, PLAYER_CHOOSER_HEIGHT(ch->winsurf)/2 },
 			.onclick = rotate_left,
 			.onclickdata = plrch,
 		},
@@ -109,7 +109,7 @@ static void setup_player_chooser(struct Chooser *ch, int idx, int scprev, int sc
 			.imgpath = "assets/resized/arrows/right.png",
 			.scancodes = {scnext},
 			.destsurf = ch->winsurf,
-			.center = { leftx + CAMERA_SCREEN_WIDTH/2 - button_width(flags)/2, PLAYER_CHOOSER_HEIGHT/2 },
+			.center = { leftx + ch->winsurf->w/2 - button_width(flags)/2, PLAYER_CHOOSER_HEIGHT(ch->winsurf)/2 },
 			.onclick = rotate_right,
 			.onclickdata = plrch,
 		},
@@ -179,7 +179,8 @@ static void show_player_chooser_each_frame(const struct Chooser *ch, struct Choo
 {
 	turn_camera(plrch);
 	SDL_FillRect(plrch->cam.surface, NULL, 0);
-	show_all(NULL, 0, ch->ellipsoids, player_nepics, &plrch->cam);
+	struct EllipsoidSpan span = { ch->ellipsoids, player_nepics };
+	show_all(NULL, NULL, 0, NULL, &span, 1, &plrch->cam);  // camera moves on every frame, nothing to remember
 }
 
 static void on_copy_clicked(void *chptr)
@@ -280,8 +281,8 @@ void chooser_init(struct Chooser *ch, SDL_Window *win)
 			.destsurf = winsurf,
 			.scancodes = { SDL_SCANCODE_RETURN, SDL_SCANCODE_SPACE },
 			.center = {
-				(LISTBOX_WIDTH + CAMERA_SCREEN_WIDTH)/2,
-				CAMERA_SCREEN_HEIGHT - button_height(0)/2,
+				(LISTBOX_WIDTH + winsurf->w)/2,
+				winsurf->h - button_height(0)/2,
 			},
 			.onclick = on_play_clicked,
 			.onclickdata = &ch->state,
@@ -292,7 +293,7 @@ void chooser_init(struct Chooser *ch, SDL_Window *win)
 			.destsurf = winsurf,
 			.scancodes = { SDL_SCANCODE_ESCAPE },
 			.center = {
-				CAMERA_SCREEN_WIDTH - button_width(BUTTON_TINY)/2 - 10,
+				winsurf->w - button_width(BUTTON_TINY)/2 - 10,
 				button_height(BUTTON_TINY)/2 + 10,
 			},
 			.onclick = on_quit_clicked,
@@ -304,9 +305,9 @@ void chooser_init(struct Chooser *ch, SDL_Window *win)
 				.destrect = {
 #define YMARGIN 5
 					.x = 0,
-					.y = PLAYER_CHOOSER_HEIGHT + YMARGIN,
+					.y = PLAYER_CHOOSER_HEIGHT(winsurf) + YMARGIN,
 					.w = LISTBOX_WIDTH,
-					.h = CAMERA_SCREEN_HEIGHT - PLAYER_CHOOSER_HEIGHT - 2*YMARGIN,
+					.h = winsurf->h - PLAYER_CHOOSER_HEIGHT(winsurf) - 2*YMARGIN,
 #undef YMARGIN
 				},
 				.upscancodes = { SDL_SCANCODE_W, SDL_SCANCODE_UP },
@@ -327,11 +328,11 @@ void chooser_init(struct Chooser *ch, SDL_Window *win)
 
 	ch->editorsurf = create_cropped_surface(winsurf, (SDL_Rect){
 		.x = LISTBOX_WIDTH,
-		.y = PLAYER_CHOOSER_HEIGHT,
-		.w = CAMERA_SCREEN_WIDTH - LISTBOX_WIDTH,
-		.h = CAMERA_SCREEN_HEIGHT - PLAYER_CHOOSER_HEIGHT - button_height(0),
+		.y = PLAYER_CHOOSER_HEIGHT(winsurf),
+		.w = winsurf->w - LISTBOX_WIDTH,
+		.h = winsurf->h - PLAYER_CHOOSER_HEIGHT(winsurf) - button_height(0),
 	});
-	ch->editor = mapeditor_new(ch->editorsurf, -0.20f*CAMERA_SCREEN_HEIGHT, 0.6f);
+	ch->editor = mapeditor_new(ch->editorsurf, -winsurf->h/5, 0.6f);
 	mapeditor_setmap(ch->editor, &ch->mapch.maps[ch->mapch.listbox.selectidx]);
 	mapeditor_setplayers(ch->editor, ch->playerch[0].epic, ch->playerch[1].epic);
 }
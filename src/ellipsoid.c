@@ -51,8 +51,93 @@ bool ellipsoid_is_visible(const struct Ellipsoid *el, const struct Camera *cam)
 	return true;
 }
 
-static SDL_Rect bbox_without_hidelowerhalf(
-	const struct Ellipsoid *el, const struct Camera *cam)
+/*
+Most ellipsoids are clearly visible or clearly not visible, and a bounding
+sphere is enough to tell that. The sphere checks are done in chunks, and the
+loops are simple enough for the compiler to vectorize them. Only ellipsoids
+that are near the edge of the view get the slower exact check.
+*/
+#define CULL_CHUNK_SIZE 16
+
+// Ellipsoids this close to the sphere check limits get the exact check, because floats aren't exact
+#define CULL_EPSILON 1e-4f
+
+enum CullResult { CULL_VISIBLE, CULL_INVISIBLE, CULL_DONT_KNOW };
+
+static void cull_chunk(const struct Ellipsoid *els, int n, const struct Plane *unitplanes, int nplanes, enum CullResult *res)
+{
+	SDL_assert(n <= CULL_CHUNK_SIZE);
+	float cx[CULL_CHUNK_SIZE], cy[CULL_CHUNK_SIZE], cz[CULL_CHUNK_SIZE], r[CULL_CHUNK_SIZE];
+	for (int i = 0; i < n; i++) {
+		cx[i] = els[i].center.x;
+		cy[i] = els[i].center.y;
+		cz[i] = els[i].center.z;
+		// rotating doesn't stretch, so the ellipsoid fits in this sphere
+		r[i] = max(els[i].xzradius, els[i].yradius);
+	}
+
+	// sure = surely fine with respect to all planes checked so far
+	// int instead of bool, because then gcc vectorizes the loops
+	int sure[CULL_CHUNK_SIZE], invisible[CULL_CHUNK_SIZE];
+	for (int i = 0; i < n; i++) {
+		sure[i] = 1;
+		invisible[i] = 0;
+	}
+
+	for (int p = 0; p < nplanes; p++) {
+		struct Plane pl = unitplanes[p];
+		float d[CULL_CHUNK_SIZE];
+		for (int i = 0; i < n; i++)
+			d[i] = pl.normal.x*cx[i] + pl.normal.y*cy[i] + pl.normal.z*cz[i] - pl.constant;
+
+		// See ellipsoid_is_visible() for what it means to be on the right side of a plane
+		if (p == CAMERA_CAMPLANE_IDX) {
+			// must be entirely in front of the camera
+			for (int i = 0; i < n; i++) {
+				invisible[i] |= (d[i] < -CULL_EPSILON);
+				sure[i] &= (d[i] > r[i] + CULL_EPSILON);
+			}
+		} else {
+			// center on the right side, or touching the plane
+			for (int i = 0; i < n; i++) {
+				invisible[i] |= (d[i] < -r[i] - CULL_EPSILON);
+				sure[i] &= (d[i] > CULL_EPSILON);
+			}
+		}
+	}
+
+	for (int i = 0; i < n; i++)
+		res[i] = invisible[i] ? CULL_INVISIBLE : sure[i] ? CULL_VISIBLE : CULL_DONT_KNOW;
+}
+
+void ellipsoid_visible_many(const struct Ellipsoid *els, int nels, const struct Camera *cam, bool *visible)
+{
+	// Plane distances are easy to compare with radiuses when normal vectors have length 1
+	struct Plane unitplanes[sizeof(cam->visplanes)/sizeof(cam->visplanes[0])];
+	for (int p = 0; p < sizeof(unitplanes)/sizeof(unitplanes[0]); p++) {
+		float len = sqrtf(vec3_dot(cam->visplanes[p].normal, cam->visplanes[p].normal));
+		unitplanes[p] = (struct Plane){
+			.normal = vec3_mul_float(cam->visplanes[p].normal, 1/len),
+			.constant = cam->visplanes[p].constant / len,
+		};
+	}
+
+	for (int start = 0; start < nels; start += CULL_CHUNK_SIZE) {
+		int n = min(CULL_CHUNK_SIZE, nels - start);
+		enum CullResult res[CULL_CHUNK_SIZE];
+		cull_chunk(&els[start], n, unitplanes, sizeof(unitplanes)/sizeof(unitplanes[0]), res);
+
+		for (int i = 0; i < n; i++) {
+			switch(res[i]) {
+				case CULL_VISIBLE: visible[start+i] = true; break;
+				case CULL_INVISIBLE: visible[start+i] = false; break;
+				case CULL_DONT_KNOW: visible[start+i] = ellipsoid_is_visible(&els[start+i], cam); break;
+			}
+		}
+	}
+}
+
+SDL_Rect ellipsoid_bbox_unclipped(const struct Ellipsoid *el, const struct Camera *cam)
 {
 	Mat3 uball2cam = mat3_mul_mat3(cam->world2cam, el->uball2world);
 
@@ -111,7 +196,7 @@ static SDL_Rect bbox_of_middle_circle(
 	const struct Ellipsoid *el, const struct Camera *cam)
 {
 	/*
-	Similar to bbox_without_hidelowerhalf.
+	Similar to ellipsoid_bbox_unclipped().
 	Doing this with the 2D circle in the middle (y=0 in unit ball coords)
 	basically leads to the same equations, but in 2D.
 	*/
@@ -157,7 +242,11 @@ static SDL_Rect bbox_of_middle_circle(
 
 SDL_Rect ellipsoid_bbox(const struct Ellipsoid *el, const struct Camera *cam)
 {
-	SDL_Rect bbox = bbox_without_hidelowerhalf(el, cam);
+	return ellipsoid_clip_bbox(el, cam, ellipsoid_bbox_unclipped(el, cam));
+}
+
+SDL_Rect ellipsoid_clip_bbox(const struct Ellipsoid *el, const struct Camera *cam, SDL_Rect bbox)
+{
 	if (el->hidelowerhalf) {
 		SDL_Rect circlebbox = bbox_of_middle_circle(el, cam);
 		bbox.h = (circlebbox.y - bbox.y) + circlebbox.h;
@@ -169,6 +258,50 @@ SDL_Rect ellipsoid_bbox(const struct Ellipsoid *el, const struct Camera *cam)
 	return res;
 }
 
+int ellipsoid_choose_miplevel(SDL_Rect unclippedbbox, int lodbias)
+{
+	// Not clipped to screen, so that ellipsoids partially outside the screen look good too
+	int size = max(unclippedbbox.w, unclippedbbox.h) >> lodbias;
+
+	// Use the smallest level that still has at least one cube cell for each pixel
+	int level = 0;
+	while (level+1 < ELLIPSOIDPIC_NLEVELS && ELLIPSOIDPIC_LEVEL_SIDE(level+1) >= size)
+		level++;
+	return level;
+}
+
+bool ellipsoid_get_impostor(
+	const struct Ellipsoid *el, const struct Camera *cam, SDL_Rect unclippedbbox, struct EllipsoidImpostor *imp)
+{
+	SDL_Rect bbox = unclippedbbox;
+	int limit = ELLIPSOIDPIC_IMPOSTOR_SIZE << cam->lodbias;
+	if (bbox.w > limit || bbox.h > limit)
+		return false;
+
+	// Direction from ellipsoid to camera, see the same formulas in ellipsoidpic.c
+	Vec3 dir = mat3_mul_vec3(el->world2uball, vec3_sub(cam->location, el->center));
+	float pi = acosf(-1);
+	float yaw = atan2f(dir.x, dir.z);
+	float pitch = atan2f(dir.y, hypotf(dir.x, dir.z));
+	if (yaw < 0)
+		yaw += 2*pi;
+
+	int yawidx = (int)(yaw / (2*pi) * ELLIPSOIDPIC_IMPOSTOR_NYAWS);
+	int pitchidx = (int)((pitch + pi/2) / pi * ELLIPSOIDPIC_IMPOSTOR_NPITCHES);
+	yawidx %= ELLIPSOIDPIC_IMPOSTOR_NYAWS;
+	clamp(&yawidx, 0, ELLIPSOIDPIC_IMPOSTOR_NYAWS-1);
+	clamp(&pitchidx, 0, ELLIPSOIDPIC_IMPOSTOR_NPITCHES-1);
+
+	*imp = (struct EllipsoidImpostor){
+		.pixels = &el->epic->impostors[el->highlighted][yawidx][pitchidx][0][0],
+		.left = (float)bbox.x,
+		.top = (float)bbox.y,
+		.width = (float)max(bbox.w, 1),
+		.height = (float)max(bbox.h, 1),
+	};
+	return true;
+}
+
 struct Rect3 ellipsoid_get_sort_rect(const struct Ellipsoid *el, const struct Camera *cam)
 {
 	Vec3 center2cam = vec3_sub(cam->location, el->center);
@@ -298,41 +431,39 @@ bool ellipsoid_xminmax(const struct Ellipsoid *el, const struct Camera *cam, int
 	return *xmin <= *xmax;
 }
 
-void ellipsoid_drawrow(
-	const struct Ellipsoid *el, const struct Camera *cam,
-	int y, int xmin, int xmax)
+// Things that are same for all pixels of a row
+struct RowInfo {
+	const struct Camera *cam;
+	float yzr;
+	Vec3 camloc;
+	float cc;
+	Mat3 M;
+	int side;
+	float halfside;
+	int nbricks;
+	const uint32_t *cube;
+};
+
+/*
+Code is ugly but gcc vectorizes it to make it very fast. This code was the
+bottleneck of the game before making it more vectorizable, and it still is
+at the time of writing this comment.
+*/
+static void draw_strip(const struct RowInfo *ri, uint32_t *px, int xmin, int xdiff)
 {
-	int xdiff = xmax - xmin;
-	if (xdiff <= 0)
-		return;
-	SDL_assert(0 <= xmin && xmin+xdiff <= cam->surface->w);
-	SDL_assert(xdiff <= CAMERA_SCREEN_WIDTH);
+	SDL_assert(xdiff <= CAMERA_STRIP_WIDTH);
+	const struct Camera *cam = ri->cam;
+	float yzr = ri->yzr;
+	Vec3 camloc = ri->camloc;
+	float cc = ri->cc;
+	Mat3 M = ri->M;
+	int side = ri->side;
+	float halfside = ri->halfside;
 
-	SDL_assert(cam->surface->pitch % sizeof(uint32_t) == 0);
-	int mypitch = cam->surface->pitch / sizeof(uint32_t);
-
-	/*
-	Code is ugly but gcc vectorizes it to make it very fast. This code was the
-	bottleneck of the game before making it more vectorizable, and it still is
-	at the time of writing this comment.
-	*/
 #define LOOP for(int i = 0; i < xdiff; i++)
-#define ARRAY(T, Name) T Name[CAMERA_SCREEN_WIDTH]; LOOP Name[i]
+#define ARRAY(T, Name) T Name[CAMERA_STRIP_WIDTH]; LOOP Name[i]
 
 	ARRAY(float, xzr) = camera_screenx_to_xzr(cam, (float)(xmin + i));
-
-	/*
-	line equation in camera coordinates:
-
-		x = xzr*z, y = yzr*z aka (x,y,z) = z*(xzr,yzr,1)
-
-	Note that the direction vector (xzr,yzr,1) is pointing towards the camera.
-	*/
-	float yzr = camera_screeny_to_yzr(cam, y);
-
-	// Line equation in unit ball coordinates:  (x,y,z) = camloc + t*linedir
-	Vec3 camloc = mat3_mul_vec3(el->world2uball, vec3_sub(cam->location, el->center));
-	Mat3 M = mat3_mul_mat3(el->world2uball, cam->cam2world);
 	ARRAY(float, linedirx) = mat3_mul_vec3(M, (Vec3){xzr[i],yzr,1}).x;
 	ARRAY(float, linediry) = mat3_mul_vec3(M, (Vec3){xzr[i],yzr,1}).y;
 	ARRAY(float, linedirz) = mat3_mul_vec3(M, (Vec3){xzr[i],yzr,1}).z;
@@ -341,7 +472,6 @@ void ellipsoid_drawrow(
 	Intersecting the ball x^2+y^2+z^2=1 with the line creates a quadratic equation in t.
 	We want the solution with bigger t, because the direction vector points towards camera.
 	*/
-	float cc = vec3_dot(camloc, camloc);
 #define LineDir(i) ( (Vec3){ linedirx[i], linediry[i], linedirz[i] } )
 	ARRAY(float, dd) = vec3_dot(LineDir(i), LineDir(i));
 	ARRAY(float, cd) = vec3_dot(camloc, LineDir(i));
@@ -357,36 +487,142 @@ void ellipsoid_drawrow(
 	ARRAY(float, vecy) = linediry[i]*t[i] + camloc.y;
 	ARRAY(float, vecz) = linedirz[i]*t[i] + camloc.z;
 
-	ARRAY(int, ex) = (int)(ELLIPSOIDPIC_SIDE/2 * (1+vecx[i]));
-	ARRAY(int, ey) = (int)(ELLIPSOIDPIC_SIDE/2 * (1+vecy[i]));
-	ARRAY(int, ez) = (int)(ELLIPSOIDPIC_SIDE/2 * (1+vecz[i]));
+	ARRAY(int, ex) = (int)(halfside * (1+vecx[i]));
+	ARRAY(int, ey) = (int)(halfside * (1+vecy[i]));
+	ARRAY(int, ez) = (int)(halfside * (1+vecz[i]));
 
 	// just in case floats do something weird, e.g. division by zero
-	LOOP clamp(&ex[i], 0, ELLIPSOIDPIC_SIDE-1);
-	LOOP clamp(&ey[i], 0, ELLIPSOIDPIC_SIDE-1);
-	LOOP clamp(&ez[i], 0, ELLIPSOIDPIC_SIDE-1);
+	LOOP clamp(&ex[i], 0, side-1);
+	LOOP clamp(&ey[i], 0, side-1);
+	LOOP clamp(&ez[i], 0, side-1);
+
+	ARRAY(int, idx) = ellipsoidpic_index(ri->nbricks, ex[i], ey[i], ez[i]);
+	LOOP px[i] = ri->cube[idx[i]];
+#undef LOOP
+#undef ARRAY
+}
+
+void ellipsoid_drawrow(
+	const struct Ellipsoid *el, const struct Camera *cam, int miplevel,
+	int y, int xmin, int xmax)
+{
+	if (xmax <= xmin)
+		return;
+	SDL_assert(0 <= xmin && xmax <= cam->surface->w);
+
+	SDL_assert(cam->surface->pitch % sizeof(uint32_t) == 0);
+	int mypitch = cam->surface->pitch / sizeof(uint32_t);
+
+	/*
+	line equation in camera coordinates:
+
+		x = xzr*z, y = yzr*z aka (x,y,z) = z*(xzr,yzr,1)
+
+	Note that the direction vector (xzr,yzr,1) is pointing towards the camera.
+	Line equation in unit ball coordinates:  (x,y,z) = camloc + t*linedir
+	*/
+	struct RowInfo ri = {
+		.cam = cam,
+		.yzr = camera_screeny_to_yzr(cam, y),
+		.camloc = mat3_mul_vec3(el->world2uball, vec3_sub(cam->location, el->center)),
+		.M = mat3_mul_mat3(el->world2uball, cam->cam2world),
+		.side = ELLIPSOIDPIC_LEVEL_SIDE(miplevel),
+		.halfside = (float)ELLIPSOIDPIC_LEVEL_SIDE(miplevel) / 2,
+		.nbricks = ELLIPSOIDPIC_LEVEL_NBRICKS(miplevel),
+		.cube = ellipsoidpic_level(el->epic, el->highlighted, miplevel),
+	};
+	ri.cc = vec3_dot(ri.camloc, ri.camloc);
+
+	uint32_t *px = (uint32_t *)cam->surface->pixels + mypitch*y;
+	for (int x = xmin; x < xmax; x += CAMERA_STRIP_WIDTH)
+		draw_strip(&ri, px + x, x, min(xmax - x, CAMERA_STRIP_WIDTH));
+}
+
+void ellipsoid_drawrow_impostor(
+	const struct EllipsoidImpostor *imp, const struct Camera *cam,
+	int y, int xmin, int xmax)
+{
+	if (xmax <= xmin)
+		return;
+	SDL_assert(0 <= xmin && xmax <= cam->surface->w);
+
+	SDL_assert(cam->surface->pitch % sizeof(uint32_t) == 0);
+	int mypitch = cam->surface->pitch / sizeof(uint32_t);
+
+	// Stretch the impostor to fill the ellipsoid's bounding box
+	int row = (int)(((float)y + 0.5f - imp->top) / imp->height * ELLIPSOIDPIC_IMPOSTOR_SIZE);
+	clamp(&row, 0, ELLIPSOIDPIC_IMPOSTOR_SIZE-1);
+	const uint32_t *src = imp->pixels + row*ELLIPSOIDPIC_IMPOSTOR_SIZE;
+	float scale = ELLIPSOIDPIC_IMPOSTOR_SIZE / imp->width;
 
-	uint32_t *px = (uint32_t *)cam->surface->pixels + mypitch*y + xmin;
-	bool hl = el->highlighted;
-	LOOP px[i] = el->epic->cubepixels[hl][ex[i]][ey[i]][ez[i]];
+	uint32_t *pxrow = (uint32_t *)cam->surface->pixels + mypitch*y;
+	for (int x = xmin; x < xmax; x += CAMERA_STRIP_WIDTH) {
+		int xdiff = min(xmax - x, CAMERA_STRIP_WIDTH);
+		uint32_t *px = pxrow + x;
+#define LOOP for(int i = 0; i < xdiff; i++)
+#define ARRAY(T, Name) T Name[CAMERA_STRIP_WIDTH]; LOOP Name[i]
+		ARRAY(int, col) = (int)(((float)(x + i) + 0.5f - imp->left) * scale);
+		LOOP clamp(&col[i], 0, ELLIPSOIDPIC_IMPOSTOR_SIZE-1);
+		LOOP px[i] = src[col[i]];
 #undef LOOP
+#undef ARRAY
+	}
 }
 
-static Mat3 diag(float a, float b, float c)
+static bool transforms_are_up_to_date(const struct Ellipsoid *el)
 {
-	return (Mat3){ .rows = {
-		{ a, 0, 0 },
-		{ 0, b, 0 },
-		{ 0, 0, c },
+	// Radii are positive, so this is false for a zero-initialized ellipsoid
+	return el->angle == el->transformangle
+		&& el->xzradius == el->transformxzradius
+		&& el->yradius == el->transformyradius;
+}
+
+/*
+The uball2world matrix is diag(r, ry, r) times a rotation. The inverse of a
+rotation is its transpose, and the inverse of a diagonal matrix is 1/ on the
+diagonal, so we don't need a general matrix inverse.
+*/
+static void set_transforms(struct Ellipsoid *el, float sin, float cos, float invr, float invry)
+{
+	float r = el->xzradius;
+	el->uball2world = (Mat3){ .rows = {
+		{ r*cos, 0,           -r*sin },
+		{ 0,     el->yradius, 0      },
+		{ r*sin, 0,           r*cos  },
+	}};
+	el->world2uball = (Mat3){ .rows = {
+		{ cos*invr,  0,     sin*invr },
+		{ 0,         invry, 0        },
+		{ -sin*invr, 0,     cos*invr },
 	}};
+
+	el->transformangle = el->angle;
+	el->transformxzradius = el->xzradius;
+	el->transformyradius = el->yradius;
 }
 
 void ellipsoid_update_transforms(struct Ellipsoid *el)
 {
-	el->uball2world = mat3_mul_mat3(
-		diag(el->xzradius, el->yradius, el->xzradius),
-		mat3_rotation_xz(el->angle));
-	el->world2uball = mat3_inverse(el->uball2world);
+	if (!transforms_are_up_to_date(el))
+		set_transforms(el, sinf(el->angle), cosf(el->angle), 1/el->xzradius, 1/el->yradius);
+}
+
+void ellipsoid_update_transforms_many(struct Ellipsoid *els, int nels)
+{
+	// Usually all ellipsoids have the same radii, e.g. unpicked guards
+	float r = -1, ry = -1, invr = 0, invry = 0;
+
+	for (int i = 0; i < nels; i++) {
+		if (transforms_are_up_to_date(&els[i]))
+			continue;
+		if (els[i].xzradius != r || els[i].yradius != ry) {
+			r = els[i].xzradius;
+			ry = els[i].yradius;
+			invr = 1/r;
+			invry = 1/ry;
+		}
+		set_transforms(&els[i], sinf(els[i].angle), cosf(els[i].angle), invr, invry);
+	}
 }
 
 void ellipsoid_move_apart(struct Ellipsoid *el1, struct Ellipsoid *el2, float mv)
@@ -409,14 +645,14 @@ void ellipsoid_move_apart(struct Ellipsoid *el1, struct Ellipsoid *el2, float mv
 	vec3_sub_inplace(&el1->center, from1to2);
 }
 
-void ellipsoid_beginjump(struct Ellipsoid *el)
+void ellipsoid_beginjump(const struct Ellipsoid *el, struct EllipsoidJumpState *js)
 {
-	SDL_assert(!el->jumpstate.jumping);
+	SDL_assert(!js->jumping);
 	log_printf("Jumper-jump begins");
-	el->jumpstate.jumping = true;
+	js->jumping = true;
 
-	float v = el->jumpstate.xzspeed;
-	el->jumpstate.speed = (Vec3){ v*sinf(el->angle), 30, -v*cosf(el->angle) };
+	float v = js->xzspeed;
+	js->speed = (Vec3){ v*sinf(el->angle), 30, -v*cosf(el->angle) };
 
 	sound_play("superboing.wav");
 }
@@ -441,19 +677,19 @@ static int clamp_with_bounce(float *val, float lo, float hi)
 	return ret;
 }
 
-void ellipsoid_jumping_eachframe(struct Ellipsoid *el, const struct Map *map)
+void ellipsoid_jumping_eachframe(struct Ellipsoid *el, struct EllipsoidJumpState *js, const struct Map *map)
 {
-	SDL_assert(el->jumpstate.jumping);
-	vec3_add_inplace(&el->center, vec3_mul_float(el->jumpstate.speed, 1.0f/CAMERA_FPS));
+	SDL_assert(js->jumping);
+	vec3_add_inplace(&el->center, vec3_mul_float(js->speed, 1.0f/CAMERA_FPS));
 
-	el->jumpstate.speed.x *= clamp_with_bounce(&el->center.x, el->xzradius, map->xsize - el->xzradius);
-	el->jumpstate.speed.y -= GRAVITY/CAMERA_FPS;
-	el->jumpstate.speed.z *= clamp_with_bounce(&el->center.z, el->xzradius, map->zsize - el->xzradius);
+	js->speed.x *= clamp_with_bounce(&el->center.x, el->xzradius, map->xsize - el->xzradius);
+	js->speed.y -= GRAVITY/CAMERA_FPS;
+	js->speed.z *= clamp_with_bounce(&el->center.z, el->xzradius, map->zsize - el->xzradius);
 
 	float centerymin = el->hidelowerhalf ? 0 : el->yradius;
-	if (el->jumpstate.speed.y < 0 && el->center.y < centerymin) {
+	if (js->speed.y < 0 && el->center.y < centerymin) {
 		log_printf("end jump");
 		el->center.y = centerymin;
-		el->jumpstate.jumping = false;
+		js->jumping = false;
 	}
 }
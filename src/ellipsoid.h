@@ -14,6 +14,49 @@ struct Map;  // IWYU pragma: keep
 // DON'T MAKE THIS TOO BIG, it uses this^3 amount of memory...
 #define ELLIPSOIDPIC_SIDE 150
 
+/*
+Far away ellipsoids are small on screen, and drawing them with the full size
+cube would jump around in a big array, which is slow. So there are also
+smaller cubes, with sides 75, 38 and 19. These are called mip levels, and
+level 0 is the full size cube.
+*/
+#define ELLIPSOIDPIC_NLEVELS 4
+#define ELLIPSOIDPIC_LEVEL_SIDE(level) ( (ELLIPSOIDPIC_SIDE + (1 << (level)) - 1) >> (level) )
+
+/*
+Each cube is stored as 4x4x4 bricks, and each brick is 256 bytes, i.e. a few
+cache lines. When drawing a row of pixels, the x and z coordinates in the cube
+change, and with the usual [x][y][z] layout, each change of x jumps to a
+completely different place in memory. With bricks, neighboring pixels usually
+come from the same brick. See cachebench.h for measuring this.
+
+Sides are rounded up to a multiple of 4, so there's a bit of unused space.
+*/
+#define ELLIPSOIDPIC_LEVEL_NBRICKS(level) ( (ELLIPSOIDPIC_LEVEL_SIDE(level) + 3) / 4 )   // in each direction
+#define ELLIPSOIDPIC_LEVEL_SIZE(level) ( 64 * ELLIPSOIDPIC_LEVEL_NBRICKS(level) \
+	* ELLIPSOIDPIC_LEVEL_NBRICKS(level) * ELLIPSOIDPIC_LEVEL_NBRICKS(level) )
+#define ELLIPSOIDPIC_TOTAL_SIZE ( ELLIPSOIDPIC_LEVEL_SIZE(0) + ELLIPSOIDPIC_LEVEL_SIZE(1) \
+	+ ELLIPSOIDPIC_LEVEL_SIZE(2) + ELLIPSOIDPIC_LEVEL_SIZE(3) )
+
+// Where is pixel (x,y,z) in a cube with the given number of bricks in each direction?
+inline int ellipsoidpic_index(int nbricks, int x, int y, int z)
+{
+	int brick = ((x >> 2)*nbricks + (y >> 2))*nbricks + (z >> 2);
+	return 64*brick + ((x & 3) << 4) + ((y & 3) << 2) + (z & 3);
+}
+
+/*
+Small ellipsoids far away are drawn from pre-rendered pictures, called
+impostors, instead of intersecting a line with the ellipsoid for each pixel.
+Ellipsoids only rotate around the y axis, so what the camera sees depends
+only on the direction from the ellipsoid to the camera in unit ball
+coordinates. There's an impostor for each combination of rounded yaw and
+pitch angles of that direction.
+*/
+#define ELLIPSOIDPIC_IMPOSTOR_SIZE 32   // width and height in pixels
+#define ELLIPSOIDPIC_IMPOSTOR_NYAWS 32
+#define ELLIPSOIDPIC_IMPOSTOR_NPITCHES 16
+
 // picture wrapped around an ellipsoid, may be shared by more than one ellipsoid
 // this struct is BIG
 struct EllipsoidPic {
@@ -28,12 +71,23 @@ struct EllipsoidPic {
 
 	/*
 	Which color to show for a given vector? Avoid slow atan2 calls when looking it
-	up by providing an array that essentially lets you do cubepixels[highlighted][x][y][z].
-	Here highlighted is usually 0, but can be 1 for different color.
+	up by providing cubes of pixels, where each (x,y,z) has a color.
+	Mip levels are one after another, and ellipsoidpic_level() finds them.
+	First index (highlighted) is usually 0, but can be 1 for different color.
 	*/
-	uint32_t cubepixels[2][ELLIPSOIDPIC_SIDE][ELLIPSOIDPIC_SIDE][ELLIPSOIDPIC_SIDE];
+	uint32_t cubepixels[2][ELLIPSOIDPIC_TOTAL_SIZE];
+
+	// Indexed by [highlighted][yaw][pitch][y][x]
+	uint32_t impostors[2][ELLIPSOIDPIC_IMPOSTOR_NYAWS][ELLIPSOIDPIC_IMPOSTOR_NPITCHES]
+		[ELLIPSOIDPIC_IMPOSTOR_SIZE][ELLIPSOIDPIC_IMPOSTOR_SIZE];
 };
 
+/*
+Returns the pixels of a mip level. Use ellipsoidpic_index() with
+ELLIPSOIDPIC_LEVEL_NBRICKS(level) to find a pixel.
+*/
+const uint32_t *ellipsoidpic_level(const struct EllipsoidPic *epic, bool highlighted, int level);
+
 // epic lmao
 // free(epic) to unload
 void ellipsoidpic_load(struct EllipsoidPic *epic, const char *path, const SDL_PixelFormat *fmt);
@@ -43,8 +97,13 @@ struct EllipsoidPic *const *ellipsoidpic_loadmany(
 	int *n, const char *globpat, const SDL_PixelFormat *fmt,
 	void (*progresscb)(void *cbdata, int i, int n), void *cbdata);
 
-// See jumper.h for code that initiates the jumps this thing represents.
-// Not to be confused with the jumping that happens when a player unflattens.
+/*
+See jumper.h for code that initiates the jumps this thing represents.
+Not to be confused with the jumping that happens when a player unflattens.
+
+This is not in struct Ellipsoid, because drawing doesn't need it. Players and
+enemies have their own jump states.
+*/
 struct EllipsoidJumpState {
 	float xzspeed;  // Set this once when creating ellipsoid
 	Vec3 speed;
@@ -79,28 +138,67 @@ struct Ellipsoid {
 	*/
 	Mat3 uball2world, world2uball;
 
-	struct EllipsoidJumpState jumpstate;
+	// angle and radii when the matrices were calculated, for skipping unnecessary updates
+	float transformangle, transformxzradius, transformyradius;
 };
 
-// calculate el->uball2world and el->world2uball
+// calculate el->uball2world and el->world2uball, if angle or radii changed
 void ellipsoid_update_transforms(struct Ellipsoid *el);
 
+// Same as calling ellipsoid_update_transforms() for each ellipsoid, but faster
+void ellipsoid_update_transforms_many(struct Ellipsoid *els, int nels);
+
 // Is the ellipsoid visible anywhere on screen?
 bool ellipsoid_is_visible(const struct Ellipsoid *el, const struct Camera *cam);
 
+/*
+Same as calling ellipsoid_is_visible() for each ellipsoid and putting results
+to visible[i], but much faster when there are many ellipsoids.
+*/
+void ellipsoid_visible_many(const struct Ellipsoid *els, int nels, const struct Camera *cam, bool *visible);
+
 // Ellipsoid will be drawn fully within the returned 2D rectangle.
 // Assumes that ellipsoid_is_visible() has returned true.
 SDL_Rect ellipsoid_bbox(const struct Ellipsoid *el, const struct Camera *cam);
 
+/*
+ellipsoid_bbox() is done in two steps, because many things need the bounding
+box of the whole ellipsoid, not clipped to the screen and ignoring
+hidelowerhalf. Computing it isn't free, so compute it once for each ellipsoid.
+*/
+SDL_Rect ellipsoid_bbox_unclipped(const struct Ellipsoid *el, const struct Camera *cam);
+SDL_Rect ellipsoid_clip_bbox(const struct Ellipsoid *el, const struct Camera *cam, SDL_Rect unclippedbbox);
+
 // Returned 3D rectangle is suitable for sorting ellipsoids and walls for display
 struct Rect3 ellipsoid_get_sort_rect(const struct Ellipsoid *el, const struct Camera *cam);
 
+/*
+Which mip level of the ellipsoid's picture should be used for drawing it?
+Bigger ellipsoids on screen get bigger levels. See ELLIPSOIDPIC_NLEVELS.
+*/
+int ellipsoid_choose_miplevel(SDL_Rect unclippedbbox, int lodbias);
+
+// Where and how to draw an ellipsoid with an impostor
+struct EllipsoidImpostor {
+	const uint32_t *pixels;   // ELLIPSOIDPIC_IMPOSTOR_SIZE rows, each ELLIPSOIDPIC_IMPOSTOR_SIZE pixels
+	float left, top, width, height;   // the whole ellipsoid on screen, not clipped
+};
+
+// Returns false if the ellipsoid is too big on screen to be drawn with an impostor
+bool ellipsoid_get_impostor(
+	const struct Ellipsoid *el, const struct Camera *cam, SDL_Rect unclippedbbox, struct EllipsoidImpostor *imp);
+
 // returns false if nothing visible for given y
 bool ellipsoid_xminmax(const struct Ellipsoid *el, const struct Camera *cam, int y, int *xmin, int *xmax);
 
 // Draw all pixels of ellipsoid corresponding to range of x coordinates
 void ellipsoid_drawrow(
-	const struct Ellipsoid *el, const struct Camera *cam,
+	const struct Ellipsoid *el, const struct Camera *cam, int miplevel,
+	int y, int xmin, int xmax);
+
+// Like ellipsoid_drawrow(), but much faster. Use ellipsoid_xminmax() in the same way.
+void ellipsoid_drawrow_impostor(
+	const struct EllipsoidImpostor *imp, const struct Camera *cam,
 	int y, int xmin, int xmax);
 
 /*
@@ -111,6 +209,12 @@ each other.
 */
 float ellipsoid_bump_amount(const struct Ellipsoid *el1, const struct Ellipsoid *el2);
 
+/*
+Same as calling ellipsoid_bump_amount(el, &others[i]) for each ellipsoid and
+putting results to bumps[i], but faster when there are many ellipsoids.
+*/
+void ellipsoid_bump_amount_many(const struct Ellipsoid *el, const struct Ellipsoid *others, int nothers, float *bumps);
+
 /*
 Move each ellipsoid away from the other one by half of the given amount without
 changing y coordinate of location
@@ -118,10 +222,10 @@ changing y coordinate of location
 void ellipsoid_move_apart(struct Ellipsoid *el1, struct Ellipsoid *el2, float mv);
 
 // can't be called during jump
-void ellipsoid_beginjump(struct Ellipsoid *el);
+void ellipsoid_beginjump(const struct Ellipsoid *el, struct EllipsoidJumpState *js);
 
 // must be called during jump
-void ellipsoid_jumping_eachframe(struct Ellipsoid *el, const struct Map *map);
+void ellipsoid_jumping_eachframe(struct Ellipsoid *el, struct EllipsoidJumpState *js, const struct Map *map);
 
 
 #endif  // ELLIPSOID_H
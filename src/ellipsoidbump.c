@@ -13,46 +13,51 @@ Finds the maximum value of
 
 	f(x) = sqrt(A1 x^2 + B1 x + C1) + sqrt(A2 x^2 + B2 x + C2)
 
-on an interval [a,b].
+on an interval [a,b], where A1 < 0 and A2 < 0. Both square roots are concave,
+so f is concave and has only one maximum, either where f'(x) = 0 or at an end
+of the interval. We find it with Newton's method for f'(x) = 0, and bisect
+instead if Newton's method would go outside the interval where the maximum
+must be. That usually needs only a few iterations.
 */
 static float find_max_value(float A1, float B1, float C1, float A2, float B2, float C2, float a, float b)
 {
 	SDL_assert(a <= b);
 
-	// https://en.wikipedia.org/wiki/Golden-section_search
-	// a < t < u < b (if a=b, loop below does nothing)
-	float phi = 1.618033988749895f;
-	float t = a + (2-phi)*(b-a);
-	float u = a + (-1+phi)*(b-a);
-
-#define f(x) (sqrtf(A1*(x)*(x) + B1*(x) + C1) + sqrtf(A2*(x)*(x) + B2*(x) + C2))
-	float ft = f(t);
-	float fu = f(u);
-
-	int iter = 0;  // just in case of nan weirdness, lol
-	while (b-a > 1e-3f) {  // Function values more precise because derivative zero at max
-		// It usually does about 20 iterations, depending only on length of input interval
-		if (iter++ == 25) {
-			log_printf("hitting max number of iterations, current interval [%f,%f]", a, b);
+	// max(..., 0) because floats aren't exact at ends of interval
+#define q1(x) max(A1*(x)*(x) + B1*(x) + C1, 0)
+#define q2(x) max(A2*(x)*(x) + B2*(x) + C2, 0)
+#define f(x) (sqrtf(q1(x)) + sqrtf(q2(x)))
+	float x = (a+b)/2;
+
+	for (int iter = 0; iter < 30; iter++) {
+		// tiny minimum to avoid dividing by zero, makes derivatives huge near the ends
+		float Q1 = max(q1(x), 1e-12f), Q2 = max(q2(x), 1e-12f);
+		float sq1 = sqrtf(Q1), sq2 = sqrtf(Q2);
+		float dQ1 = 2*A1*x + B1, dQ2 = 2*A2*x + B2;
+
+		// d/dx sqrt(q) = q'/(2 sqrt(q)) and d^2/dx^2 sqrt(q) = (2 q'' q - q'^2) / (4 q sqrt(q))
+		float fprime = dQ1/(2*sq1) + dQ2/(2*sq2);
+		float fprimeprime = (4*A1*Q1 - dQ1*dQ1)/(4*Q1*sq1) + (4*A2*Q2 - dQ2*dQ2)/(4*Q2*sq2);
+
+		// Concave, so maximum is on the side where f increases
+		if (fprime > 0)
+			a = x;
+		else
+			b = x;
+
+		float next = x - fprime/fprimeprime;
+		if (!(a < next && next < b))   // also handles nan
+			next = (a+b)/2;
+
+		bool done = fabsf(next - x) < 1e-5f;
+		x = next;
+		if (done)
 			break;
-		}
-		if (ft < fu) {
-			// Increases between t and u, max can't be on [a,t]
-			a = t;
-			t = u;  // magic constants using phi chosen so that this works
-			ft = fu;
-			u = a + (-1+phi)*(b-a);
-			fu = f(u);
-		} else {
-			b = u;
-			u = t;
-			fu = ft;
-			t = a + (2-phi)*(b-a);
-			ft = f(t);
-		}
 	}
-	return f((t+u)/2);
+	return f(x);
 #undef f
+#undef q1
+#undef q2
 }
 
 /*
@@ -130,38 +135,61 @@ float ellipse_bump_amount(
 	return max(xdiff, 0);
 }
 
+// Doesn't do the bounding sphere check
+static float bump_amount_without_spheres(const struct Ellipsoid *el1, const struct Ellipsoid *el2)
+{
+	if (el1->center.y < el2->center.y) {
+		const struct Ellipsoid *tmp = el1;
+		el1 = el2;
+		el2 = tmp;
+	}
+
+	/*
+	Ellipsoids look the same from all xz directions, so this is a 2D problem
+	on the vertical plane that goes through both centers. We don't need to
+	rotate anything to get there, because only the horizontal distance of the
+	centers matters. If they line up vertically, we get distance 0, and
+	moving in any direction is fine.
+	*/
+	float xzdist = hypotf(el1->center.x - el2->center.x, el1->center.z - el2->center.z);
+	return ellipse_bump_amount(
+		el1->xzradius, el1->yradius, (Vec2){ xzdist, el1->center.y }, el1->hidelowerhalf,
+		el2->xzradius, el2->yradius, (Vec2){ 0, el2->center.y });
+}
+
 float ellipsoid_bump_amount(const struct Ellipsoid *el1, const struct Ellipsoid *el2)
 {
 	// optimization for common case
 	float d = max(el1->xzradius, el1->yradius) + max(el2->xzradius, el2->yradius);
 	if (vec3_lengthSQUARED(vec3_sub(el1->center, el2->center)) > d*d)
 		return 0;
+	return bump_amount_without_spheres(el1, el2);
+}
 
-	if (el1->center.y < el2->center.y) {
-		const struct Ellipsoid *tmp = el1;
-		el1 = el2;
-		el2 = tmp;
-	}
+#define BUMP_CHUNK_SIZE 16
 
-	Vec3 diff = vec3_sub(el1->center, el2->center);
-	float cos = diff.x/hypotf(diff.x, diff.z);
-	float sin = diff.z/hypotf(diff.x, diff.z);
-	if (!isfinite(cos) || !isfinite(sin)) {
-		// Ellipsoids lined up vertically, just move in some direction lol
-		cos = 1;
-		sin = 0;
-	}
+void ellipsoid_bump_amount_many(const struct Ellipsoid *el, const struct Ellipsoid *others, int nothers, float *bumps)
+{
+	float r = max(el->xzradius, el->yradius);
+
+	for (int start = 0; start < nothers; start += BUMP_CHUNK_SIZE) {
+		int n = min(BUMP_CHUNK_SIZE, nothers - start);
+		const struct Ellipsoid *chunk = &others[start];
+
+		// Same bounding sphere check as in ellipsoid_bump_amount(), in separate loops so that gcc vectorizes them
+		float dx[BUMP_CHUNK_SIZE], dy[BUMP_CHUNK_SIZE], dz[BUMP_CHUNK_SIZE], d[BUMP_CHUNK_SIZE];
+		for (int i = 0; i < n; i++) {
+			dx[i] = chunk[i].center.x - el->center.x;
+			dy[i] = chunk[i].center.y - el->center.y;
+			dz[i] = chunk[i].center.z - el->center.z;
+			d[i] = r + max(chunk[i].xzradius, chunk[i].yradius);
+		}
 
-	// Rotate centers so that ellipsoid centers have same z coordinate
-	Mat3 rot = mat3_inverse(mat3_rotation_xz_sincos(sin, cos));
-	Vec3 center1 = mat3_mul_vec3(rot, el1->center);
-	Vec3 center2 = mat3_mul_vec3(rot, el2->center);
-	SDL_assert(fabsf(center1.z - center2.z) < 1e-5f);
+		int far[BUMP_CHUNK_SIZE];   // int instead of bool, because then gcc vectorizes the loop
+		for (int i = 0; i < n; i++)
+			far[i] = (dx[i]*dx[i] + dy[i]*dy[i] + dz[i]*dz[i] > d[i]*d[i]);
 
-	// Now this is a 2D problem on the xy plane (or some other plane parallel to xy plane)
-	Vec2 center1_xy = { center1.x, center1.y };
-	Vec2 center2_xy = { center2.x, center2.y };
-	return ellipse_bump_amount(
-		el1->xzradius, el1->yradius, center1_xy, el1->hidelowerhalf,
-		el2->xzradius, el2->yradius, center2_xy);
+		for (int i = 0; i < n; i++)
+			bumps[start+i] = far[i] ? 0 : bump_amount_without_spheres(el, &chunk[i]);
+	}
 }
@@ -10,6 +10,9 @@
 #include "misc.h"
 #include "glob.h"
 
+// non-static inlines are weird in c
+extern inline int ellipsoidpic_index(int nbricks, int x, int y, int z);
+
 #define IS_TRANSPARENT(alpha) ((alpha) < 0x80)
 
 // yes, rgb math is bad ikr
@@ -80,6 +83,111 @@ static const AngleArray *get_angle_array(void)
 	return (const AngleArray *) &res;
 }
 
+const uint32_t *ellipsoidpic_level(const struct EllipsoidPic *epic, bool highlighted, int level)
+{
+	SDL_assert(0 <= level && level < ELLIPSOIDPIC_NLEVELS);
+	const uint32_t *ptr = epic->cubepixels[highlighted];
+	for (int k = 0; k < level; k++)
+		ptr += ELLIPSOIDPIC_LEVEL_SIZE(k);
+	return ptr;
+}
+
+/*
+Each pixel of the smaller level is the average of 2x2x2 pixels in the bigger
+level. Averaging makes distant ellipsoids look a bit smoother, instead of
+picking random-ish pixels of the full size picture.
+*/
+static void create_smaller_level(struct EllipsoidPic *epic, int level)
+{
+	int bigside = ELLIPSOIDPIC_LEVEL_SIDE(level-1);
+	int side = ELLIPSOIDPIC_LEVEL_SIDE(level);
+	int bignbricks = ELLIPSOIDPIC_LEVEL_NBRICKS(level-1);
+	int nbricks = ELLIPSOIDPIC_LEVEL_NBRICKS(level);
+	const uint32_t *big = ellipsoidpic_level(epic, false, level-1);
+	uint32_t *small = (uint32_t *)ellipsoidpic_level(epic, false, level);
+	uint32_t *smallhl = (uint32_t *)ellipsoidpic_level(epic, true, level);
+	uint32_t red = epic->pixfmt->Rmask;
+
+	for (int x = 0; x < side; x++)
+	for (int y = 0; y < side; y++)
+	for (int z = 0; z < side; z++)
+	{
+		uint32_t rsum = 0, gsum = 0, bsum = 0;
+		for (int dx = 0; dx < 2; dx++)
+		for (int dy = 0; dy < 2; dy++)
+		for (int dz = 0; dz < 2; dz++)
+		{
+			// odd sides don't divide evenly, then last pixel gets used twice
+			int bx = min(2*x + dx, bigside-1);
+			int by = min(2*y + dy, bigside-1);
+			int bz = min(2*z + dz, bigside-1);
+			uint8_t r, g, b;
+			SDL_GetRGB(big[ellipsoidpic_index(bignbricks, bx, by, bz)], epic->pixfmt, &r, &g, &b);
+			rsum += r;
+			gsum += g;
+			bsum += b;
+		}
+
+		int i = ellipsoidpic_index(nbricks, x, y, z);
+		small[i] = SDL_MapRGB(epic->pixfmt, (uint8_t)(rsum/8), (uint8_t)(gsum/8), (uint8_t)(bsum/8));
+		smallhl[i] = rgb_average(small[i], red);
+	}
+}
+
+// Color of a point on the unit ball x^2+y^2+z^2=1
+static uint32_t get_color(const struct EllipsoidPic *epic, bool highlighted, int level, Vec3 p)
+{
+	int side = ELLIPSOIDPIC_LEVEL_SIDE(level);
+	int x = (int)((float)side/2 * (1+p.x));
+	int y = (int)((float)side/2 * (1+p.y));
+	int z = (int)((float)side/2 * (1+p.z));
+	clamp(&x, 0, side-1);
+	clamp(&y, 0, side-1);
+	clamp(&z, 0, side-1);
+	return ellipsoidpic_level(epic, highlighted, level)[ellipsoidpic_index(ELLIPSOIDPIC_LEVEL_NBRICKS(level), x, y, z)];
+}
+
+/*
+Draws the unit ball as seen from far away in direction dir. In the impostor,
+x goes right and y goes down, just like on the screen.
+*/
+static void create_impostor(struct EllipsoidPic *epic, int yawidx, int pitchidx)
+{
+	// Middle of the range of directions, see ellipsoid_get_impostor()
+	float pi = acosf(-1);
+	float yaw = 2*pi*((float)yawidx + 0.5f)/ELLIPSOIDPIC_IMPOSTOR_NYAWS;
+	float pitch = -pi/2 + pi*((float)pitchidx + 0.5f)/ELLIPSOIDPIC_IMPOSTOR_NPITCHES;
+	Vec3 dir = { cosf(pitch)*sinf(yaw), sinf(pitch), cosf(pitch)*cosf(yaw) };
+
+	// y axis is up in both world and unit ball coordinates
+	Vec3 right = vec3_withlength(vec3_cross((Vec3){0,1,0}, dir), 1);
+	Vec3 up = vec3_cross(dir, right);
+
+	// Smallest mip level that has enough pixels
+	int level = 0;
+	while (level+1 < ELLIPSOIDPIC_NLEVELS && ELLIPSOIDPIC_LEVEL_SIDE(level+1) >= ELLIPSOIDPIC_IMPOSTOR_SIZE)
+		level++;
+
+	for (int iy = 0; iy < ELLIPSOIDPIC_IMPOSTOR_SIZE; iy++) {
+		for (int ix = 0; ix < ELLIPSOIDPIC_IMPOSTOR_SIZE; ix++) {
+			float u = 2*((float)ix + 0.5f)/ELLIPSOIDPIC_IMPOSTOR_SIZE - 1;
+			float v = 1 - 2*((float)iy + 0.5f)/ELLIPSOIDPIC_IMPOSTOR_SIZE;
+
+			// Corners are outside the ball, but can be drawn near the edges of the ellipsoid
+			float len = hypotf(u, v);
+			if (len > 1) {
+				u /= len;
+				v /= len;
+			}
+			float w = sqrtf(max(0, 1 - u*u - v*v));
+			Vec3 p = vec3_add(vec3_add(vec3_mul_float(right, u), vec3_mul_float(up, v)), vec3_mul_float(dir, w));
+
+			for (int hl = 0; hl < 2; hl++)
+				epic->impostors[hl][yawidx][pitchidx][iy][ix] = get_color(epic, hl, level, p);
+		}
+	}
+}
+
 void ellipsoidpic_load(
 	struct EllipsoidPic *epic, const char *path, const SDL_PixelFormat *fmt)
 {
@@ -112,12 +220,21 @@ void ellipsoidpic_load(
 		SDL_assert(0 <= picx && picx < filew);
 
 		size_t i = (size_t)( (picy*filew + picx)*4 );
-		epic->cubepixels[false][x][y][z] = SDL_MapRGB(
+		int cubeidx = ellipsoidpic_index(ELLIPSOIDPIC_LEVEL_NBRICKS(0), x, y, z);
+		epic->cubepixels[false][cubeidx] = SDL_MapRGB(
 			epic->pixfmt, filedata[i], filedata[i+1], filedata[i+2]);
-		epic->cubepixels[true][x][y][z] = rgb_average(epic->cubepixels[false][x][y][z], red);
+		epic->cubepixels[true][cubeidx] = rgb_average(epic->cubepixels[false][cubeidx], red);
 	}
 
 	stbi_image_free(filedata);
+
+	for (int level = 1; level < ELLIPSOIDPIC_NLEVELS; level++)
+		create_smaller_level(epic, level);
+
+	for (int yaw = 0; yaw < ELLIPSOIDPIC_IMPOSTOR_NYAWS; yaw++) {
+		for (int pitch = 0; pitch < ELLIPSOIDPIC_IMPOSTOR_NPITCHES; pitch++)
+			create_impostor(epic, yaw, pitch);
+	}
 }
 
 // no way to pass data to atexit callbacks
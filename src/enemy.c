@@ -3,12 +3,15 @@
 #include <math.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <SDL2/SDL.h>
 #include "camera.h"
 #include "ellipsoid.h"
+#include "flowfield.h"
 #include "linalg.h"
 #include "log.h"
 #include "misc.h"
+#include "prng.h"
 #include "wall.h"
 
 #define IMAGE_FILE_COUNT 1
@@ -24,28 +27,45 @@ void enemy_init_epics(const SDL_PixelFormat *fmt)
 	SDL_assert(ellipsoid_pics != NULL);
 }
 
-const struct EllipsoidPic *enemy_getrandomepic(void)
+const struct EllipsoidPic *enemy_getrandomepic(struct Prng *prng)
 {
-	return ellipsoid_pics[rand() % n_ellipsoid_pics];
+	// Pictures are not loaded when simulating games without a window.
+	// Getting a random number anyway keeps the game same as with a window.
+	uint64_t r = prng_next(prng);
+	if (!ellipsoid_pics)
+		return NULL;
+	return ellipsoid_pics[(r >> 32) % (uint64_t)n_ellipsoid_pics];
 }
 
-struct Enemy enemy_new(const struct Map *map, struct MapCoords loc)
+const struct EllipsoidPic *enemy_find_epic(const char *path)
 {
-	struct Enemy res = {
-		.ellipsoid = {
-			.center = { loc.x + 0.5f, 0, loc.z + 0.5f },
-			.epic = enemy_getrandomepic(),
-			.hidelowerhalf = true,
-			.angle = 0,
-			.xzradius = ENEMY_XZRADIUS,
-			.yradius = ENEMY_YRADIUS,
-		},
+	if (!ellipsoid_pics)
+		return NULL;
+	for (int i = 0; i < n_ellipsoid_pics; i++) {
+		if (!strcmp(ellipsoid_pics[i]->path, path))
+			return ellipsoid_pics[i];
+	}
+	log_printf("enemy picture \"%s\" not found, using \"%s\" instead", path, ellipsoid_pics[0]->path);
+	return ellipsoid_pics[0];
+}
+
+struct Enemy enemy_new(const struct Map *map, struct MapCoords loc, struct Ellipsoid *el, struct Prng *prng)
+{
+	*el = (struct Ellipsoid){
+		.center = { loc.x + 0.5f, 0, loc.z + 0.5f },
+		.epic = enemy_getrandomepic(prng),
+		.hidelowerhalf = true,
+		.angle = 0,
+		.xzradius = ENEMY_XZRADIUS,
+		.yradius = ENEMY_YRADIUS,
+	};
+	ellipsoid_update_transforms(el);
+
+	return (struct Enemy){
 		.dir = ENEMY_DIR_XPOS,
 		.flags = 0,
 		.map = map,
 	};
-	ellipsoid_update_transforms(&res.ellipsoid);
-	return res;
 }
 
 static enum EnemyDir opposite_direction(enum EnemyDir d)
@@ -63,11 +83,20 @@ static enum EnemyDir opposite_direction(enum EnemyDir d)
 This runs when the enemy is in the middle of a 1x1 square with integer coordinates
 for corners, i.e. when center x and z coordinates are of the form someinteger+0.5
 */
-static void begin_turning(struct Enemy *en)
+static void begin_turning(struct Enemy *en, const struct Ellipsoid *el, struct Prng *prng, const struct FlowField *ff)
 {
 	SDL_assert(!(en->flags & ENEMY_TURNING));
 	en->flags |= ENEMY_TURNING;
 
+	// Hunting enemies walk randomly only when they can't get any closer to a player
+	if (ff) {
+		int dir = flowfield_get_dir(ff, (int) floorf(el->center.x), (int) floorf(el->center.z));
+		if (dir != -1) {
+			en->dir = (enum EnemyDir)dir;
+			return;
+		}
+	}
+
 	bool cango[] = {
 		[ENEMY_DIR_XPOS] = true,
 		[ENEMY_DIR_XNEG] = true,
@@ -89,8 +118,8 @@ static void begin_turning(struct Enemy *en)
 	V
 	z
 	*/
-	int x = (int) floorf(en->ellipsoid.center.x);
-	int z = (int) floorf(en->ellipsoid.center.z);
+	int x = (int) floorf(el->center.x);
+	int z = (int) floorf(el->center.z);
 
 	for (int i = 0; i < en->map->nwalls; i++) {
 		struct Wall w = en->map->walls[i];
@@ -124,7 +153,7 @@ static void begin_turning(struct Enemy *en)
 
 	// choose random direction, at least one of them is available (lol)
 	while (true) {
-		enum EnemyDir dir = rand() % 4;
+		enum EnemyDir dir = prng_int(prng, 4);
 		if (cango[dir]) {
 			en->dir = dir;
 			return;
@@ -150,7 +179,7 @@ static bool integer_between_floats(float a, float b, int *ptr)
 }
 
 // If checkturn is false, then don't check whether the enemy should turn instead of moving more
-static void move_coordinate(float *coord, float delta, struct Enemy *en, bool checkturn)
+static void move_coordinate(float *coord, float delta, struct Enemy *en, const struct Ellipsoid *el, struct Prng *prng, const struct FlowField *ff, bool checkturn)
 {
 	float old = *coord - 0.5f;    // integer coordinate = turning point
 	float new = old + delta;
@@ -159,22 +188,22 @@ static void move_coordinate(float *coord, float delta, struct Enemy *en, bool ch
 	if (checkturn && integer_between_floats(old, new, &turningpoint)) {
 		// must move to turning point and then turn
 		*coord = (float)turningpoint + 0.5f;
-		begin_turning(en);
+		begin_turning(en, el, prng, ff);
 	} else {
 		*coord = new + 0.5f;
 	}
 }
 
-static void move(struct Enemy *en, bool checkturn)
+static void move(struct Enemy *en, struct Ellipsoid *el, struct Prng *prng, const struct FlowField *ff, bool checkturn)
 {
 	SDL_assert(!(en->flags & ENEMY_STUCK));
 
 	float amount = 2.5f / CAMERA_FPS;
 	switch(en->dir) {
-		case ENEMY_DIR_XPOS: move_coordinate(&en->ellipsoid.center.x, +amount, en, checkturn); break;
-		case ENEMY_DIR_XNEG: move_coordinate(&en->ellipsoid.center.x, -amount, en, checkturn); break;
-		case ENEMY_DIR_ZPOS: move_coordinate(&en->ellipsoid.center.z, +amount, en, checkturn); break;
-		case ENEMY_DIR_ZNEG: move_coordinate(&en->ellipsoid.center.z, -amount, en, checkturn); break;
+		case ENEMY_DIR_XPOS: move_coordinate(&el->center.x, +amount, en, el, prng, ff, checkturn); break;
+		case ENEMY_DIR_XNEG: move_coordinate(&el->center.x, -amount, en, el, prng, ff, checkturn); break;
+		case ENEMY_DIR_ZPOS: move_coordinate(&el->center.z, +amount, en, el, prng, ff, checkturn); break;
+		case ENEMY_DIR_ZNEG: move_coordinate(&el->center.z, -amount, en, el, prng, ff, checkturn); break;
 	}
 }
 
@@ -233,29 +262,29 @@ static float dir_to_angle(enum EnemyDir dir)
 	return atan2f((float)zdiff, (float)xdiff) + pi/2;
 }
 
-void enemy_eachframe(struct Enemy *en, const struct Map *map)
+void enemy_eachframe(struct Enemy *en, struct Ellipsoid *el, const struct Map *map, struct Prng *prng, const struct FlowField *ff)
 {
 	// A bit unnecessary to do this each frame, but works
-	en->ellipsoid.jumpstate.xzspeed = 2*MOVE_UNITS_PER_SECOND;
+	en->jumpstate.xzspeed = 2*MOVE_UNITS_PER_SECOND;
 
-	if (en->ellipsoid.jumpstate.jumping) {
-		ellipsoid_jumping_eachframe(&en->ellipsoid, map);
+	if (en->jumpstate.jumping) {
+		ellipsoid_jumping_eachframe(el, &en->jumpstate, map);
 	} else {
-		en->ellipsoid.center.y = 0;
+		el->center.y = 0;
 
 		float angleincr = 4.0f / CAMERA_FPS;
 		if (en->flags & ENEMY_STUCK) {
 			// just spin forever...
-			en->ellipsoid.angle += angleincr;
+			el->angle += angleincr;
 		} else if (en->flags & ENEMY_TURNING) {
-			bool done = turn(&en->ellipsoid.angle, angleincr, dir_to_angle(en->dir));
+			bool done = turn(&el->angle, angleincr, dir_to_angle(en->dir));
 			if (done) {
 				en->flags &= ~ENEMY_TURNING;
-				move(en, false);
+				move(en, el, prng, ff, false);
 			}
 		} else {
-			move(en, true);
+			move(en, el, prng, ff, true);
 		}
-		ellipsoid_update_transforms(&en->ellipsoid);
+		ellipsoid_update_transforms(el);
 	}
 }
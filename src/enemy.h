@@ -4,6 +4,7 @@
 #include <SDL2/SDL.h>
 #include "ellipsoid.h"
 #include "map.h"
+#include "prng.h"
 
 #define ENEMY_XZRADIUS 0.45f
 #define ENEMY_YRADIUS  1.2f
@@ -20,21 +21,34 @@ enum EnemyFlags {
 	ENEMY_TURNING = 0x02,   // soon will be looking into enemy->dir direction
 };
 
+/*
+Only the things that drawing doesn't need. The ellipsoids of enemies are in a
+separate array, so that drawing and bumping don't go through these. See
+GameState in gamestate.h.
+*/
 struct Enemy {
 	const struct Map *map;
-	struct Ellipsoid ellipsoid;
+	struct EllipsoidJumpState jumpstate;
 	enum EnemyFlags flags;
 	enum EnemyDir dir;
 };
 
 // call enemy_init_epics() once before calling enemy_new() as many times as you like
 void enemy_init_epics(const SDL_PixelFormat *fmt);
-struct Enemy enemy_new(const struct Map *map, struct MapCoords loc);
+struct Enemy enemy_new(const struct Map *map, struct MapCoords loc, struct Ellipsoid *el, struct Prng *prng);
 
-const struct EllipsoidPic *enemy_getrandomepic(void);
+const struct EllipsoidPic *enemy_getrandomepic(struct Prng *prng);
 
-// runs fps times per second for each enemy
-void enemy_eachframe(struct Enemy *en, const struct Map *map);
+// Returns some other picture if path not found, and NULL if pictures aren't loaded
+const struct EllipsoidPic *enemy_find_epic(const char *path);
+
+struct FlowField;   // flowfield.h includes this file
+
+/*
+Runs fps times per second for each enemy, el is the ellipsoid of the enemy.
+If ff is NULL, the enemy walks randomly. Otherwise it hunts players (see flowfield.h).
+*/
+void enemy_eachframe(struct Enemy *en, struct Ellipsoid *el, const struct Map *map, struct Prng *prng, const struct FlowField *ff);
 
 
 #endif   // ENEMY_H
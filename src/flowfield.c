@@ -0,0 +1,112 @@
+#include "flowfield.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "enemy.h"
+#include "linalg.h"
+#include "map.h"
+#include "max.h"
+#include "misc.h"
+#include "wall.h"
+
+extern inline int flowfield_get_dir(const struct FlowField *ff, int x, int z);
+
+// Same order as enum EnemyDir, and d^1 is the opposite of direction d
+static_assert(ENEMY_DIR_XPOS == 0 && ENEMY_DIR_XNEG == 1 && ENEMY_DIR_ZPOS == 2 && ENEMY_DIR_ZNEG == 3, "");
+static const int xdiffs[] = { +1, -1, 0, 0 };
+static const int zdiffs[] = { 0, 0, +1, -1 };
+
+static void block(struct FlowField *ff, int x, int z, enum EnemyDir dir)
+{
+	if (0 <= x && x < MAX_MAPSIZE && 0 <= z && z < MAX_MAPSIZE)
+		ff->blocked[x][z] |= 1 << dir;
+}
+
+// Map doesn't change while playing, so this runs only once
+static void find_blocked_directions(struct FlowField *ff, const struct Map *map)
+{
+	memset(ff->blocked, 0, sizeof(ff->blocked));
+	for (int i = 0; i < map->nwalls; i++) {
+		struct Wall w = map->walls[i];
+		switch(w.dir) {
+		case WALL_DIR_XY:
+			block(ff, w.startx, w.startz, ENEMY_DIR_ZNEG);
+			block(ff, w.startx, w.startz - 1, ENEMY_DIR_ZPOS);
+			break;
+		case WALL_DIR_ZY:
+			block(ff, w.startx, w.startz, ENEMY_DIR_XNEG);
+			block(ff, w.startx - 1, w.startz, ENEMY_DIR_XPOS);
+			break;
+		}
+	}
+	ff->map = map;
+}
+
+static struct MapCoords square_of_point(const struct Map *map, Vec3 p)
+{
+	// Players can be exactly on the edge of the map, e.g. x = xsize
+	struct MapCoords res = { (int)floorf(p.x), (int)floorf(p.z) };
+	clamp(&res.x, 0, map->xsize - 1);
+	clamp(&res.z, 0, map->zsize - 1);
+	return res;
+}
+
+static void breadth_first_search(struct FlowField *ff)
+{
+	const struct Map *map = ff->map;
+	memset(ff->dist, -1, sizeof(ff->dist));
+	memset(ff->dir, -1, sizeof(ff->dir));
+
+	// Each square goes to the queue at most once, so it doesn't need to wrap around
+	static_assert(MAX_MAPSIZE*MAX_MAPSIZE < 32768, "");
+	struct MapCoords queue[MAX_MAPSIZE*MAX_MAPSIZE];
+	int qstart = 0, qend = 0;
+
+	for (int i = 0; i < ff->ntargets; i++) {
+		struct MapCoords t = ff->targets[i];
+		if (ff->dist[t.x][t.z] == -1) {
+			ff->dist[t.x][t.z] = 0;
+			queue[qend++] = t;
+		}
+	}
+
+	while (qstart < qend) {
+		struct MapCoords cur = queue[qstart++];
+		for (enum EnemyDir d = 0; d < 4; d++) {
+			if (ff->blocked[cur.x][cur.z] & (1 << d))
+				continue;
+			int x = cur.x + xdiffs[d];
+			int z = cur.z + zdiffs[d];
+			if (x < 0 || x >= map->xsize || z < 0 || z >= map->zsize || ff->dist[x][z] != -1)
+				continue;
+
+			// From the new square, go back to where the search came from
+			ff->dist[x][z] = (short)(ff->dist[cur.x][cur.z] + 1);
+			ff->dir[x][z] = (signed char)(d ^ 1);
+			queue[qend++] = (struct MapCoords){x,z};
+		}
+	}
+}
+
+void flowfield_update(struct FlowField *ff, const struct Map *map, const Vec3 *targets, int ntargets)
+{
+	SDL_assert(0 < ntargets && ntargets <= FLOWFIELD_MAX_TARGETS);
+	SDL_assert(map->xsize <= MAX_MAPSIZE && map->zsize <= MAX_MAPSIZE);
+
+	bool changed = (ff->map != map || ff->ntargets != ntargets);
+	if (ff->map != map)
+		find_blocked_directions(ff, map);
+
+	for (int i = 0; i < ntargets; i++) {
+		struct MapCoords sq = square_of_point(map, targets[i]);
+		if (sq.x != ff->targets[i].x || sq.z != ff->targets[i].z)
+			changed = true;
+		ff->targets[i] = sq;
+	}
+	ff->ntargets = ntargets;
+
+	if (changed)
+		breadth_first_search(ff);
+}
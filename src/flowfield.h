@@ -0,0 +1,46 @@
+/*
+With --hunting-enemies, enemies walk towards the nearest player instead of
+choosing random directions. Finding a path separately for each enemy would be
+slow with hundreds of enemies, so instead there's one breadth-first search
+that starts from the squares of all players at once. Each square gets the
+direction of the next square on a shortest path to the nearest player, and
+enemies just look it up when they are in the middle of a square.
+
+The search runs again only when a player moves to a different square.
+*/
+
+#ifndef FLOWFIELD_H
+#define FLOWFIELD_H
+
+#include <stdbool.h>
+#include "enemy.h"
+#include "linalg.h"
+#include "map.h"
+#include "max.h"
+
+#define FLOWFIELD_MAX_TARGETS MAX_PLAYERS
+
+// Zero-initialized FlowField is fine, the first flowfield_update() fills it
+struct FlowField {
+	const struct Map *map;   // NULL if nothing computed yet
+	unsigned char blocked[MAX_MAPSIZE][MAX_MAPSIZE];   // bit 1<<dir set if wall on that side
+
+	struct MapCoords targets[FLOWFIELD_MAX_TARGETS];
+	int ntargets;
+
+	short dist[MAX_MAPSIZE][MAX_MAPSIZE];   // number of squares to nearest target, -1 if unreachable
+	signed char dir[MAX_MAPSIZE][MAX_MAPSIZE];   // enum EnemyDir, or -1 at target or if unreachable
+};
+
+// Does nothing if the targets are in the same squares as last time
+void flowfield_update(struct FlowField *ff, const struct Map *map, const Vec3 *targets, int ntargets);
+
+// Where to go from square (x,z), or -1 if staying is as good as anything
+inline int flowfield_get_dir(const struct FlowField *ff, int x, int z)
+{
+	if (x < 0 || x >= ff->map->xsize || z < 0 || z >= ff->map->zsize)
+		return -1;
+	return ff->dir[x][z];
+}
+
+#endif   // FLOWFIELD_H
@@ -0,0 +1,367 @@
+#include "gamestate.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "camera.h"
+#include "ellipsoid.h"
+#include "enemy.h"
+#include "flowfield.h"
+#include "guard.h"
+#include "jumper.h"
+#include "log.h"
+#include "map.h"
+#include "max.h"
+#include "misc.h"
+#include "player.h"
+#include "prng.h"
+#include "profiler.h"
+#include "sound.h"
+
+static bool time_to_do_something(unsigned *frameptr, unsigned thisframe, unsigned delay)
+{
+	// https://yarchive.net/comp/linux/unsigned_arithmetic.html
+	if (thisframe - *frameptr > delay) {
+		*frameptr += delay;
+		return true;
+	}
+	return false;
+}
+
+void gamestate_reserve_enemies(struct GameState *gs, int n)
+{
+	// Both arrays always have room for the same number of enemies
+	int elsalloced = gs->enemiesalloced;
+	gs->enemyels = grow_array(gs->enemyels, &elsalloced, n, sizeof(gs->enemyels[0]));
+	gs->enemies = grow_array(gs->enemies, &gs->enemiesalloced, n, sizeof(gs->enemies[0]));
+}
+
+static void add_enemy(struct GameState *gs, const struct MapCoords *coordptr)
+{
+	if (gs->map->nenemylocs == 0) {  // avoid crash in "% 0" below
+		log_printf("map has no enemies");
+		return;
+	}
+
+	struct MapCoords pc;
+	if (coordptr)
+		pc = *coordptr;
+	else {
+		// Choose random enemy location.
+		// Does not take in account region size, otherwise small regions are too safe.
+		pc = gs->map->enemylocs[prng_int(&gs->prng, gs->map->nenemylocs)];
+	}
+
+	gamestate_reserve_enemies(gs, gs->nenemies + 1);
+	gs->enemies[gs->nenemies] = enemy_new(gs->map, pc, &gs->enemyels[gs->nenemies], &gs->prng);
+	gs->nenemies++;
+}
+
+// runs each frame
+static void add_guards_and_enemies_as_needed(struct GameState *gs)
+{
+	int n = 3;
+	float nprob = 0.2f;    // probability to get stack of n guards instead of 1 guard
+
+	/*
+	The frequency of enemies appearing, as enemies per frame on average, is
+
+		1/enemydelay,
+
+	because we get one enemy in enemydelay frames. The expected value of guards
+	to get (aka weighted average of guard counts with probabilities as weights) is
+
+		nprob*n + (1 - nprob)*1,
+
+	so the frequency of guards appearing is
+
+		(nprob*n + (1 - nprob)*1)/guarddelay.
+
+	If enemy and guard frequencies are equal, we have a balance of enemies and
+	guards. Setting the frequencies equal allows me to solve guarddelay given enemydelay.
+	We can still set enemydelay however we want.
+	*/
+	unsigned enemydelay = 5*CAMERA_FPS;
+	unsigned guarddelay = (unsigned)( (nprob*n + (1 - nprob)*1)*enemydelay );
+
+	/*
+	People make mistakes, and the enemies win eventually, even with the variables we have
+	now, but that can take a very long time.
+	Also make sure that small areas containing a spawning point are not too safe.
+	*/
+	enemydelay = (unsigned)(enemydelay * 0.6f);
+	if (gs->map->nenemylocs != 0)
+		enemydelay /= gs->map->nenemylocs;
+
+	gs->thisframe++;
+	if (time_to_do_something(&gs->lastguardframe, gs->thisframe, guarddelay)) {
+		int toadd = (prng_float(&gs->prng) < nprob) ? n : 1;
+		log_printf("There are %d unpicked guards, adding %d more", gs->unpicked_guards.n, toadd);
+		guard_create_unpickeds_random(&gs->unpicked_guards, toadd, gs->map, &gs->prng);
+	}
+	if (time_to_do_something(&gs->lastenemyframe, gs->thisframe, enemydelay)) {
+		log_printf("There are %d enemies, adding one more", gs->nenemies);
+		add_enemy(gs, NULL);
+	}
+}
+
+/*
+Players 2 and 3 go to the other side of the map from players 0 and 1. Picking
+the spot doesn't use the prng, so games with 2 players stay as they were.
+*/
+static struct MapCoords get_player_location(const struct Map *map, int i)
+{
+	if (i < 2)
+		return map->playerlocs[i];
+	struct MapCoords hint = map->playerlocs[i-2];
+	hint.z = map->zsize - 1 - hint.z;
+	return map_findempty(map, hint);
+}
+
+struct GameState *gamestate_new(
+	const struct Map *map,
+	const struct EllipsoidPic *const *plrpics, int nplayers,
+	uint64_t seed, bool huntingenemies)
+{
+	SDL_assert(2 <= nplayers && nplayers <= MAX_PLAYERS);
+
+	// calloc because there's no other good way to zero-initialize a big struct without using stack
+	struct GameState *gs = calloc(1, sizeof(*gs));
+	if (!gs)
+		log_printf_abort("not enough memory for game state");
+
+	prng_seed(&gs->prng, seed);
+	gs->map = map;
+	gs->huntingenemies = huntingenemies;
+	gs->nplayers = nplayers;
+
+	for (int i = 0; i < nplayers; i++) {
+		struct MapCoords loc = get_player_location(map, i);
+		gs->players[i].ellipsoid = (struct Ellipsoid){
+			.angle = 0,
+			.epic = plrpics ? plrpics[i] : NULL,
+			.center = { loc.x + 0.5f, 0, loc.z + 0.5f },
+		};
+	}
+
+	for (int i = 0; i < map->nenemylocs; i++)
+		add_enemy(gs, &map->enemylocs[i]);
+
+	for (int i = 0; i < map->njumpers; i++)
+		gs->jumpers[i] = (struct Jumper){
+			.x = map->jumperlocs[i].x,
+			.z = map->jumperlocs[i].z,
+		};
+	return gs;
+}
+
+struct GameState *gamestate_copy(const struct GameState *gs)
+{
+	struct GameState *res = malloc(sizeof(*res));
+	if (!res)
+		log_printf_abort("not enough memory for game state");
+	*res = *gs;
+
+	// Pointers must not point into the original
+	res->enemyels = NULL;
+	res->enemies = NULL;
+	res->enemiesalloced = 0;
+	gamestate_reserve_enemies(res, gs->nenemies);
+	memcpy(res->enemyels, gs->enemyels, gs->nenemies*sizeof(gs->enemyels[0]));
+	memcpy(res->enemies, gs->enemies, gs->nenemies*sizeof(gs->enemies[0]));
+
+	res->unpicked_guards = (struct UnpickedGuards){0};
+	guard_copy_unpickeds(&res->unpicked_guards, &gs->unpicked_guards);
+
+	res->bumps = NULL;
+	res->bumpsalloced = 0;
+	return res;
+}
+
+void gamestate_free(struct GameState *gs)
+{
+	if (gs) {
+		free(gs->enemyels);
+		free(gs->enemies);
+		guard_free_unpickeds(&gs->unpicked_guards);
+		free(gs->bumps);
+	}
+	free(gs);
+}
+
+const int gamestate_player_keys[MAX_PLAYERS][PLAYER_NKEYS] = {
+	// many keyboards have numpad with zero right next to the "→" arrow, like "f" is next to "d"
+	{ SDL_SCANCODE_A, SDL_SCANCODE_D, SDL_SCANCODE_W, SDL_SCANCODE_S, SDL_SCANCODE_F },
+	{ SDL_SCANCODE_LEFT, SDL_SCANCODE_RIGHT, SDL_SCANCODE_UP, SDL_SCANCODE_DOWN, SDL_SCANCODE_0 },
+	{ SDL_SCANCODE_J, SDL_SCANCODE_L, SDL_SCANCODE_I, SDL_SCANCODE_K, SDL_SCANCODE_U },
+	// the 6 keys above arrow keys, laid out like arrow keys
+	{ SDL_SCANCODE_DELETE, SDL_SCANCODE_PAGEDOWN, SDL_SCANCODE_HOME, SDL_SCANCODE_END, SDL_SCANCODE_INSERT },
+};
+
+bool gamestate_handle_key(struct GameState *gs, int scancode, bool down)
+{
+	scancode = normalize_scancode(scancode);
+	for (int p = 0; p < gs->nplayers; p++) {
+		const int *keys = gamestate_player_keys[p];
+		struct Player *plr = &gs->players[p];
+
+		if (scancode == keys[PLAYER_KEY_LEFT])
+			player_set_turning(plr, -1, down);
+		else if (scancode == keys[PLAYER_KEY_RIGHT])
+			player_set_turning(plr, +1, down);
+		else if (scancode == keys[PLAYER_KEY_MOVE])
+			player_set_moving(plr, down);
+		else if (scancode == keys[PLAYER_KEY_FLAT])
+			player_set_flat(plr, down);
+		else if (scancode == keys[PLAYER_KEY_DROP]) {
+			if (down)
+				player_drop_guard(plr, &gs->unpicked_guards);
+		} else
+			continue;
+		return true;
+	}
+	return false;
+}
+
+static void handle_players_bumping_each_other(struct GameState *gs)
+{
+	for (int i = 0; i < gs->nplayers; i++) {
+		for (int k = i+1; k < gs->nplayers; k++) {
+			struct Player *plr0 = &gs->players[i], *plr1 = &gs->players[k];
+			float bump = ellipsoid_bump_amount(&plr0->ellipsoid, &plr1->ellipsoid);
+			if (bump != 0) {
+				log_printf("players %d and %d bump into each other", i, k);
+				ellipsoid_move_apart(&plr0->ellipsoid, &plr1->ellipsoid, bump);
+			}
+		}
+	}
+}
+
+/*
+In these functions, deleting moves the last element to the deleted index. It
+was already handled, because the loops go backwards, so the bumps stay valid.
+*/
+
+// Returns an array with room for a bump amount of each ellipsoid
+static float *get_bumps_array(struct GameState *gs, int nels)
+{
+	gs->bumps = grow_array(gs->bumps, &gs->bumpsalloced, nels, sizeof(gs->bumps[0]));
+	return gs->bumps;
+}
+
+static void handle_players_bumping_enemies(struct GameState *gs)
+{
+	float *bumps = get_bumps_array(gs, gs->nenemies);
+	for (int p = 0; p < gs->nplayers; p++) {
+		ellipsoid_bump_amount_many(&gs->players[p].ellipsoid, gs->enemyels, gs->nenemies, bumps);
+		for (int e = gs->nenemies - 1; e >= 0; e--) {
+			if (bumps[e] != 0) {
+				log_printf(
+					"enemy %d/%d hits player %d (%d guards)",
+					e, gs->nenemies,
+					p, gs->players[p].nguards);
+				sound_play("farts/fart*.wav");
+				int nguards = --gs->players[p].nguards;   // can become negative
+
+				/*
+				If the game is over, then don't delete the enemy. This way it
+				shows up in game over screen.
+				*/
+				if (nguards >= 0) {
+					gs->nenemies--;
+					gs->enemies[e] = gs->enemies[gs->nenemies];
+					gs->enemyels[e] = gs->enemyels[gs->nenemies];
+				}
+			}
+		}
+	}
+}
+
+static void handle_enemies_bumping_unpicked_guards(struct GameState *gs)
+{
+	float *bumps = get_bumps_array(gs, gs->unpicked_guards.n);
+	for (int e = gs->nenemies - 1; e >= 0; e--) {
+		ellipsoid_bump_amount_many(&gs->enemyels[e], gs->unpicked_guards.els, gs->unpicked_guards.n, bumps);
+		for (int u = gs->unpicked_guards.n - 1; u >= 0; u--) {
+			if (bumps[u] != 0) {
+				log_printf("enemy %d/%d destroys unpicked guard %d/%d",
+					e, gs->nenemies, u, gs->unpicked_guards.n);
+				sound_play("farts/fart*.wav");
+				guard_remove_unpicked(&gs->unpicked_guards, u);
+			}
+		}
+	}
+}
+
+static void handle_players_bumping_unpicked_guards(struct GameState *gs)
+{
+	float *bumps = get_bumps_array(gs, gs->unpicked_guards.n);
+	for (int p = 0; p < gs->nplayers; p++) {
+		ellipsoid_bump_amount_many(&gs->players[p].ellipsoid, gs->unpicked_guards.els, gs->unpicked_guards.n, bumps);
+		for (int u = gs->unpicked_guards.n - 1; u >= 0; u--) {
+			if (bumps[u] != 0) {
+				log_printf(
+					"player %d (%d guards) picks unpicked guard %d/%d",
+					p, gs->players[p].nguards, u, gs->unpicked_guards.n);
+				sound_play("pick.wav");
+				guard_remove_unpicked(&gs->unpicked_guards, u);
+				gs->players[p].nguards++;
+			}
+		}
+	}
+}
+
+void gamestate_eachframe(struct GameState *gs)
+{
+	uint64_t start = profiler_start();
+	add_guards_and_enemies_as_needed(gs);
+	guard_unpickeds_eachframe(&gs->unpicked_guards);
+
+	const struct FlowField *ff = NULL;
+	if (gs->huntingenemies) {
+		Vec3 plrcenters[MAX_PLAYERS];
+		for (int i = 0; i < gs->nplayers; i++)
+			plrcenters[i] = gs->players[i].ellipsoid.center;
+		flowfield_update(&gs->flowfield, gs->map, plrcenters, gs->nplayers);
+		ff = &gs->flowfield;
+	}
+	for (int i = 0; i < gs->nenemies; i++) {
+		enemy_eachframe(&gs->enemies[i], &gs->enemyels[i], gs->map, &gs->prng, ff);
+		for (int k = 0; k < gs->map->njumpers; k++)
+			jumper_press(&gs->jumpers[k], &gs->enemyels[i], &gs->enemies[i].jumpstate);
+	}
+	for (int i = 0; i < gs->nplayers; i++) {
+		player_eachframe(&gs->players[i], gs->map);
+		for (int k = 0; k < gs->map->njumpers; k++)
+			jumper_press(&gs->jumpers[k], &gs->players[i].ellipsoid, &gs->players[i].jumpstate);
+	}
+	for (int i = 0; i < gs->map->njumpers; i++)
+		jumper_eachframe(&gs->jumpers[i]);
+	profiler_stop("moving things", start);
+
+	start = profiler_start();
+	handle_players_bumping_each_other(gs);
+	handle_players_bumping_enemies(gs);
+	handle_enemies_bumping_unpicked_guards(gs);
+	handle_players_bumping_unpicked_guards(gs);
+	profiler_stop("bumping", start);
+}
+
+int gamestate_winner(const struct GameState *gs)
+{
+	int loser = -1;
+	for (int i = 0; i < gs->nplayers && loser == -1; i++) {
+		if (gs->players[i].nguards < 0)
+			loser = i;
+	}
+	if (loser == -1)
+		return -1;
+
+	int winner = -1;
+	for (int i = 0; i < gs->nplayers; i++) {
+		if (i != loser && (winner == -1 || gs->players[i].nguards > gs->players[winner].nguards))
+			winner = i;
+	}
+	return winner;
+}
@@ -0,0 +1,104 @@
+/*
+The game logic of play.c without any drawing. This runs fps times per second
+while playing, and it also works without a window (see simulate.c).
+*/
+
+#ifndef GAMESTATE_H
+#define GAMESTATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+#include "ellipsoid.h"
+#include "enemy.h"
+#include "flowfield.h"
+#include "guard.h"
+#include "jumper.h"
+#include "map.h"
+#include "max.h"
+#include "player.h"
+#include "prng.h"
+
+/*
+Includes all the GameObjects that all players should see. There is no global
+state, so many games can run at the same time in different threads.
+*/
+struct GameState {
+	const struct Map *map;
+	struct Prng prng;   // everything random in the game comes from here
+
+	struct Player players[MAX_PLAYERS];
+	int nplayers;   // 2 to MAX_PLAYERS
+
+	/*
+	Enemy number i is enemies[i] and enemyels[i]. The ellipsoids are separate,
+	so that show_all() can use the array without copying it, and drawing and
+	bumping loops don't go through enemy states. They still go through whole
+	ellipsoids, including matrices that culling and bumping don't need.
+	Both arrays have room for enemiesalloced enemies, and they grow as needed.
+	*/
+	struct Ellipsoid *enemyels;
+	struct Enemy *enemies;
+	int nenemies, enemiesalloced;
+
+	bool huntingenemies;   // if true, enemies walk towards players instead of walking randomly
+	struct FlowField flowfield;   // not used for random walking
+
+	struct UnpickedGuards unpicked_guards;
+
+	unsigned thisframe;
+	unsigned lastenemyframe, lastguardframe;
+
+	struct Jumper jumpers[MAX_JUMPERS];
+
+	// for bumping many ellipsoids at once, reused on each frame
+	float *bumps;
+	int bumpsalloced;
+};
+
+enum PlayerKey { PLAYER_KEY_LEFT, PLAYER_KEY_RIGHT, PLAYER_KEY_MOVE, PLAYER_KEY_FLAT, PLAYER_KEY_DROP, PLAYER_NKEYS };
+
+// Scancodes of each player's keys, after normalize_scancode()
+extern const int gamestate_player_keys[MAX_PLAYERS][PLAYER_NKEYS];
+
+/*
+Same seed, same huntingenemies, same number of players and same key presses at
+the same frames always give the same game.
+
+Players 0 and 1 start at the player locations of the map. Other players start
+at empty places on the other side of the map.
+
+plrpics can be NULL when the game won't be shown.
+
+Player cameras don't get a surface, so cam.surface and cam.screencentery must
+be set before showing anything. They can be left unset without a window.
+
+Use gamestate_free() when done.
+*/
+struct GameState *gamestate_new(
+	const struct Map *map,
+	const struct EllipsoidPic *const *plrpics, int nplayers,
+	uint64_t seed, bool huntingenemies);
+
+// Everything is copied, so that the copy can be used while the original changes
+struct GameState *gamestate_copy(const struct GameState *gs);
+void gamestate_free(struct GameState *gs);
+
+// For setting enemies and nenemies directly, e.g. when loading a snapshot
+void gamestate_reserve_enemies(struct GameState *gs, int n);
+
+// Press or release a key of some player. Returns false for keys that players don't use.
+bool gamestate_handle_key(struct GameState *gs, int scancode, bool down);
+
+// runs fps times per second
+void gamestate_eachframe(struct GameState *gs);
+
+/*
+The game ends when a player runs out of guards. Of the other players, the one
+with the most guards wins, or the first of them if there's a tie. Returns index
+of the player who won, or -1 if the game isn't over yet.
+*/
+int gamestate_winner(const struct GameState *gs);
+
+
+#endif   // GAMESTATE_H
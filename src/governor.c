@@ -0,0 +1,84 @@
+#include "governor.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include "camera.h"
+#include "log.h"
+#include "max.h"
+#include "misc.h"
+
+/*
+Cheapest first: lod bias is barely visible, and fewer picked guards only
+matters for players with a lot of guards. Low resolution looks bad, so it
+comes last.
+*/
+static const struct Quality levels[GOVERNOR_NLEVELS] = {
+	{ 1,     0, MAX_PICKED_GUARDS_TO_DISPLAY_PER_PLAYER, 0 },
+	{ 1,     1, MAX_PICKED_GUARDS_TO_DISPLAY_PER_PLAYER, 0 },
+	{ 1,     1, 16, 30 },
+	{ 0.75f, 1, 16, 30 },
+	{ 0.75f, 2, 8,  20 },
+	{ 0.5f,  2, 8,  20 },
+	{ 0.5f,  3, 4,  12 },
+};
+
+#define SMOOTHING 0.1f   // how much the latest frame affects the smoothed frame time
+#define DOWN_WAIT (CAMERA_FPS/4)   // let the smoothed time settle before lowering quality again
+#define UP_WAIT (2*CAMERA_FPS)
+#define MAX_UP_WAIT (30*CAMERA_FPS)
+
+bool governor_update(struct Governor *gov, float frameseconds)
+{
+	if (gov->frametime == 0)
+		gov->frametime = frameseconds;
+	else
+		gov->frametime += SMOOTHING*(frameseconds - gov->frametime);
+	if (gov->upwait == 0)
+		gov->upwait = UP_WAIT;
+	gov->frames++;
+
+	// Better quality has been fine for a while, so old slowdowns don't matter anymore
+	if (gov->level < gov->prevlevel && gov->frames >= UP_WAIT)
+		gov->upwait = UP_WAIT;
+
+	float budget = 1.0f / CAMERA_FPS;
+	int old = gov->level;
+
+	if (gov->frametime > 0.9f*budget && gov->frames >= DOWN_WAIT && gov->level < GOVERNOR_NLEVELS-1) {
+		// Better quality was too slow after all, don't try it again so soon
+		if (gov->level < gov->prevlevel && gov->frames < UP_WAIT)
+			gov->upwait = min(2*gov->upwait, MAX_UP_WAIT);
+		gov->level++;
+	} else if (gov->frametime < 0.6f*budget && gov->frames >= gov->upwait && gov->level > 0) {
+		gov->level--;
+	}
+
+	if (gov->level == old)
+		return false;
+
+	gov->prevlevel = old;
+	gov->frames = 0;
+	char desc[200];
+	governor_describe(gov, desc, sizeof desc);
+	log_printf("quality level %d/%d: %s", gov->level, GOVERNOR_NLEVELS-1, desc);
+	return true;
+}
+
+struct Quality governor_quality(const struct Governor *gov)
+{
+	return levels[gov->level];
+}
+
+void governor_describe(const struct Governor *gov, char *buf, int sizeofbuf)
+{
+	struct Quality q = levels[gov->level];
+	if (gov->level == 0) {
+		snprintf(buf, sizeofbuf, "full quality");
+		return;
+	}
+
+	char dd[50] = "unlimited";
+	if (q.drawdistance > 0)
+		snprintf(dd, sizeof dd, "%.0f", q.drawdistance);
+	snprintf(buf, sizeofbuf, "%d%% resolution, lod bias %d, %d picked guards, draw distance %s",
+		(int)(q.resolution*100), q.lodbias, q.maxpickedguards, dd);
+}
@@ -0,0 +1,45 @@
+/*
+The quality governor makes drawing faster when the game lags, so that the game
+doesn't slow down on slow computers. It watches a smoothed frame time and
+steps through quality levels: when frames take too long, it goes to the next
+level, and when there's plenty of time left, it goes back.
+
+Level 0 is full quality. Each level after that makes some of these worse:
+- resolution: draw to a smaller surface and stretch it to the window
+- lodbias: use smaller mipmaps and impostors for bigger ellipsoids
+- maxpickedguards: how many picked guards are shown on top of each player
+- drawdistance: things further away than this aren't shown
+*/
+
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <stdbool.h>
+
+struct Quality {
+	float resolution;   // 1 for full resolution, 0.5 for half width and half height
+	int lodbias;        // see struct Camera
+	int maxpickedguards;
+	float drawdistance;   // 0 means no limit
+};
+
+// Zero-initialized Governor is at full quality
+struct Governor {
+	float frametime;   // smoothed, in seconds, 0 if no frames yet
+	int level;
+	int prevlevel;   // before the latest change
+	int frames;   // since level changed
+	int upwait;   // how many frames to wait before going back to better quality, 0 means default
+};
+
+#define GOVERNOR_NLEVELS 7
+
+// Call after each frame with the time spent on the frame. Returns true if quality changed.
+bool governor_update(struct Governor *gov, float frameseconds);
+
+struct Quality governor_quality(const struct Governor *gov);
+
+// e.g. "75% resolution, lod bias 1, 16 picked guards, draw distance 20"
+void governor_describe(const struct Governor *gov, char *buf, int sizeofbuf);
+
+#endif   // GOVERNOR_H
@@ -1,6 +1,8 @@
 #include "guard.h"
+#include <math.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <SDL2/SDL.h>
 #include "camera.h"
 #include "ellipsoid.h"
@@ -8,6 +10,7 @@
 #include "log.h"
 #include "max.h"
 #include "misc.h"
+#include "prng.h"
 
 #define YRADIUS_BASIC 1.0f
 #define SPACING_BASIC 0.2f
@@ -22,29 +25,83 @@ void guard_init_epic(const SDL_PixelFormat *fmt)
 	ellipsoidpic_load(&guard_ellipsoidpic, "assets/guard.png", fmt);
 }
 
-// this function could be slow with many nonpicked guards
-static bool nonpicked_guard_center_in_use(Vec3 center, const struct Ellipsoid *others, int nothers)
+const struct EllipsoidPic *guard_get_epic(void)
 {
-	for (int i = 0; i < nothers; i++) {
-		if (vec3_lengthSQUARED(vec3_sub(center, others[i].center)) < 0.001)
-			return true;
+	return &guard_ellipsoidpic;
+}
+
+/*
+Guard centers closer than sqrt(0.001) to each other are in the same place. The
+hash table cells are bigger than that, so it's enough to look at neighbor cells.
+*/
+#define CELL_SIZE (1/16.0f)
+
+static int cell_coord(float f)
+{
+	return (int)floorf(f / CELL_SIZE);
+}
+
+static int bucket_of_cell(int cellx, int cellz)
+{
+	unsigned h = (unsigned)cellx*73856093u ^ (unsigned)cellz*19349663u;
+	return (int)(h & (GUARD_NBUCKETS - 1));
+}
+
+static int bucket_of_guard(const struct UnpickedGuards *ug, int idx)
+{
+	return bucket_of_cell(cell_coord(ug->els[idx].center.x), cell_coord(ug->els[idx].center.z));
+}
+
+static void add_to_bucket(struct UnpickedGuards *ug, int idx)
+{
+	int b = bucket_of_guard(ug, idx);
+	ug->next[idx] = ug->buckets[b];
+	ug->buckets[b] = idx + 1;
+}
+
+static void remove_from_bucket(struct UnpickedGuards *ug, int idx)
+{
+	int *ptr = &ug->buckets[bucket_of_guard(ug, idx)];
+	while (*ptr != idx + 1) {
+		SDL_assert(*ptr != 0);
+		ptr = &ug->next[*ptr - 1];
 	}
-	return false;
+	*ptr = ug->next[idx];
 }
 
-int guard_create_unpickeds_center(
-	struct Ellipsoid *guards, int *nguards, int howmany2add, Vec3 center)
+static bool center_in_use(const struct UnpickedGuards *ug, Vec3 center)
 {
-	int canadd = MAX_UNPICKED_GUARDS - *nguards;
-	if (howmany2add > canadd) {
-		log_printf("hitting MAX_UNPICKED_GUARDS=%d and adding only %d guards (%d requested)",
-			MAX_UNPICKED_GUARDS, canadd, howmany2add);
-		howmany2add = canadd;
+	int cellx = cell_coord(center.x);
+	int cellz = cell_coord(center.z);
+
+	for (int dx = -1; dx <= 1; dx++) {
+		for (int dz = -1; dz <= 1; dz++) {
+			// Other cells can be in the same bucket, but they are far and don't match
+			int b = bucket_of_cell(cellx + dx, cellz + dz);
+			for (int i = ug->buckets[b] - 1; i != -1; i = ug->next[i] - 1) {
+				if (vec3_lengthSQUARED(vec3_sub(center, ug->els[i].center)) < 0.001)
+					return true;
+			}
+		}
 	}
+	return false;
+}
+
+void guard_reserve_unpickeds(struct UnpickedGuards *ug, int n)
+{
+	// Both arrays always have room for the same number of guards
+	int nextalloced = ug->alloced;
+	ug->next = grow_array(ug->next, &nextalloced, n, sizeof(ug->next[0]));
+	ug->els = grow_array(ug->els, &ug->alloced, n, sizeof(ug->els[0]));
+}
+
+void guard_create_unpickeds_center(struct UnpickedGuards *ug, int howmany2add, Vec3 center)
+{
 	SDL_assert(howmany2add >= 0);
+	guard_reserve_unpickeds(ug, ug->n + howmany2add);
 
 	for (int i = 0; i < howmany2add; i++) {
-		while (nonpicked_guard_center_in_use(center, guards, *nguards))
+		while (center_in_use(ug, center))
 			center.y += SPACING_BASIC;
 
 		struct Ellipsoid el = {
@@ -56,23 +113,61 @@ int guard_create_unpickeds_center(
 			.yradius = YRADIUS_BASIC,
 		};
 		ellipsoid_update_transforms(&el);
-		guards[(*nguards)++] = el;
+		ug->els[ug->n] = el;
+		add_to_bucket(ug, ug->n++);
 	}
-	SDL_assert(*nguards <= MAX_UNPICKED_GUARDS);
-	return howmany2add;
 }
 
-int guard_create_unpickeds_random(
-	struct Ellipsoid *guards, int *nguards, int howmany2add, const struct Map *map)
+void guard_create_unpickeds_random(
+	struct UnpickedGuards *ug, int howmany2add, const struct Map *map, struct Prng *prng)
+{
+	Vec3 center = { prng_int(prng, map->xsize) + 0.5f, 0, prng_int(prng, map->zsize) + 0.5f };
+	guard_create_unpickeds_center(ug, howmany2add, center);
+}
+
+void guard_remove_unpicked(struct UnpickedGuards *ug, int idx)
+{
+	SDL_assert(0 <= idx && idx < ug->n);
+	remove_from_bucket(ug, idx);
+
+	int last = --ug->n;
+	if (idx != last) {
+		remove_from_bucket(ug, last);
+		ug->els[idx] = ug->els[last];
+		add_to_bucket(ug, idx);
+	}
+}
+
+void guard_reindex_unpickeds(struct UnpickedGuards *ug)
+{
+	SDL_assert(ug->n <= ug->alloced);
+	memset(ug->buckets, 0, sizeof(ug->buckets));
+	for (int i = 0; i < ug->n; i++)
+		add_to_bucket(ug, i);
+}
+
+void guard_copy_unpickeds(struct UnpickedGuards *dst, const struct UnpickedGuards *src)
+{
+	SDL_assert(dst->n == 0);
+	guard_reserve_unpickeds(dst, src->n);
+	memcpy(dst->els, src->els, src->n * sizeof(src->els[0]));
+	memcpy(dst->next, src->next, src->n * sizeof(src->next[0]));
+	memcpy(dst->buckets, src->buckets, sizeof(src->buckets));
+	dst->n = src->n;
+}
+
+void guard_free_unpickeds(struct UnpickedGuards *ug)
 {
-	Vec3 center = { (rand() % map->xsize) + 0.5f, 0, (rand() % map->zsize) + 0.5f };
-	return guard_create_unpickeds_center(guards, nguards, howmany2add, center);
+	free(ug->els);
+	free(ug->next);
+	*ug = (struct UnpickedGuards){0};
 }
 
-void guard_unpicked_eachframe(struct Ellipsoid *el)
+void guard_unpickeds_eachframe(struct UnpickedGuards *ug)
 {
-	el->angle += 3.0f / CAMERA_FPS;
-	ellipsoid_update_transforms(el);
+	for (int i = 0; i < ug->n; i++)
+		ug->els[i].angle += 3.0f / CAMERA_FPS;
+	ellipsoid_update_transforms_many(ug->els, ug->n);
 }
 
 int guard_create_picked(struct Ellipsoid *arr, const struct Player *plr)
@@ -6,27 +6,63 @@
 #include "ellipsoid.h"
 #include "map.h"
 #include "player.h"
+#include "prng.h"
 
 #define GUARD_XZRADIUS 0.25f
 
+// must be power of two
+#define GUARD_NBUCKETS 1024
+
+/*
+Unpicked guards, and a hash table of them by x and z coordinates. Guards added
+to the same place go on top of each other, and the hash table makes it fast to
+find the guards that are already there. Don't add or remove guards without
+using the functions below, so that the hash table stays up to date.
+
+There's no max number of guards, the arrays grow as needed. A zero-initialized
+struct is empty. Call guard_free_unpickeds() when done.
+*/
+struct UnpickedGuards {
+	struct Ellipsoid *els;
+	int n, alloced;
+
+	// Indexes are stored plus one, so that a zero-initialized struct is empty
+	int buckets[GUARD_NBUCKETS];   // first guard of each bucket plus one, 0 if bucket is empty
+	int *next;   // next guard in the same bucket plus one, 0 for last
+};
+
 // call this before any other guard functions
 void guard_init_epic(const SDL_PixelFormat *fmt);
 
+// All guards use the same picture
+const struct EllipsoidPic *guard_get_epic(void);
+
 /*
 All guards added to exactly the same x and z values go on top of each other, so
 the y coordinate of the center is not always used exactly as it is given.
 The center argument is the center of the bottom of the visible half of the guard.
-Guards array never grows larger than MAX_UNPICKED_GUARDS.
 The _random suffixed function chooses the center randomly to fit the map.
-These functions return the number of guards actually added (without overflowing the array)
 */
-int guard_create_unpickeds_center(
-	struct Ellipsoid *guards, int *nguards, int howmany2add, Vec3 center);
-int guard_create_unpickeds_random(
-	struct Ellipsoid *guards, int *nguards, int howmany2add, const struct Map *map);
+void guard_create_unpickeds_center(struct UnpickedGuards *ug, int howmany2add, Vec3 center);
+void guard_create_unpickeds_random(
+	struct UnpickedGuards *ug, int howmany2add, const struct Map *map, struct Prng *prng);
+
+// Moves the last guard to the given index
+void guard_remove_unpicked(struct UnpickedGuards *ug, int idx);
+
+/*
+For setting els and n without the functions above, e.g. when loading a snapshot.
+Make room for the guards first, and then call guard_reindex_unpickeds().
+*/
+void guard_reserve_unpickeds(struct UnpickedGuards *ug, int n);
+void guard_reindex_unpickeds(struct UnpickedGuards *ug);
+
+// dst must be empty, e.g. zero-initialized
+void guard_copy_unpickeds(struct UnpickedGuards *dst, const struct UnpickedGuards *src);
+void guard_free_unpickeds(struct UnpickedGuards *ug);
 
-// don't run this for picked guards
-void guard_unpicked_eachframe(struct Ellipsoid *el);
+// spins all unpicked guards, runs fps times per second
+void guard_unpickeds_eachframe(struct UnpickedGuards *ug);
 
 /*
 example:
@@ -41,15 +41,21 @@ static struct Interval *remove_overlaps(struct Interval in, struct Interval *bot
 	return top;
 }
 
-int interval_non_overlapping(const struct Interval *in, int inlen, struct Interval *out)
+int interval_non_overlapping(const struct Interval *in, int inlen, struct Interval **out, int *outalloced)
 {
-	struct Interval *top = out;
+	int n = 0;
 	for (int i = 0; i < inlen; i++) {
+		/*
+		Each interval already in the result can split into two pieces, and then
+		the new interval is added. Usually the result doesn't grow much, so
+		there's no need to know the worst case of all inlen intervals beforehand.
+		*/
+		*out = grow_array(*out, outalloced, 2*n + 1, sizeof((*out)[0]));
+		struct Interval *top = *out + n;
 		if (!in[i].allowoverlap)
-			top = remove_overlaps(in[i], out, top);
+			top = remove_overlaps(in[i], *out, top);
 		*top++ = in[i];
+		n = top - *out;
 	}
-
-	SDL_assert(out <= top && top <= out + INTERVAL_NON_OVERLAPPING_MAX(inlen));
-	return (top - out);
+	return n;
 }
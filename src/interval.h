@@ -17,30 +17,14 @@ struct Interval {
 };
 
 /*
-Given n intervals, we want an upper bound for how many non-overlapping intervals
-they will be turned into.
+Removes parts of intervals that are under later intervals. The result goes to
+*out, which is reallocated as needed, and *outalloced is its size. Start with
+NULL and 0, and keep using the same array to avoid reallocating on every call.
 
-Let f(n) denote the value that we want for this macro. Let's look at interval.c.
-- If there is just one input interval, then the resulting array contains that
-  interval unchanged.
-
-	f(1) = 1
-
-- If we add the n+1'th interval, then each of the n previous intervals can result
-  in adding one more interval, and we also add the n+1'th interval:
-
-	f(n+1) = f(n) + n + 1
-
-f(n) can be solved from these equations.
-*/
-#define INTERVAL_NON_OVERLAPPING_MAX(n) ( ((n) + (n)*(n))/2 )
-
-/*
-The out array must have room for INTERVAL_NON_OVERLAPPING_MAX(inlen) elements.
-Actual length of out array is returned. The allowoverlap values of the resulting
-intervals are not meaningful.
+Actual length of the result is returned. The allowoverlap values of the
+resulting intervals are not meaningful.
 */
-int interval_non_overlapping(const struct Interval *in, int inlen, struct Interval *out);
+int interval_non_overlapping(const struct Interval *in, int inlen, struct Interval **out, int *outalloced);
 
 
 #endif   // INTERVAL_H
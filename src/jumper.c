@@ -40,11 +40,14 @@ void jumper_init_global_images(const SDL_PixelFormat *pixfmt)
 	atexit(free_images);
 }
 
-struct Rect3 jumper_eachframe(struct Jumper *jmp)
+void jumper_eachframe(struct Jumper *jmp)
 {
 	jmp->y += 1.0f / CAMERA_FPS;
 	clamp_float(&jmp->y, 0, MAX_HEIGHT);
+}
 
+struct Rect3 jumper_to_rect3(const struct Jumper *jmp)
+{
 	SDL_assert(jumper_image != NULL && highlighted_jumper_image != NULL);
 	return (struct Rect3){
 		.corners = {
@@ -57,7 +60,7 @@ struct Rect3 jumper_eachframe(struct Jumper *jmp)
 	};
 }
 
-void jumper_press(struct Jumper *jmp, struct Ellipsoid *el)
+void jumper_press(struct Jumper *jmp, const struct Ellipsoid *el, struct EllipsoidJumpState *js)
 {
 	// When looking from the side, jmp is a horizontal line and el is a 2D ellipse.
 	float dx = (jmp->x+0.5f) - el->center.x;
@@ -90,6 +93,6 @@ void jumper_press(struct Jumper *jmp, struct Ellipsoid *el)
 	jmp->y = min(jmp->y, h);
 	clamp_float(&jmp->y, 0, MAX_HEIGHT);
 
-	if (h < MAX_HEIGHT/5 && !el->jumpstate.jumping)
-		ellipsoid_beginjump(el);
+	if (h < MAX_HEIGHT/5 && !js->jumping)
+		ellipsoid_beginjump(el, js);
 }
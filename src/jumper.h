@@ -17,13 +17,16 @@ struct Jumper {
 	bool highlight;
 };
 
+// runs fps times per second, moves the jumper back up after pressing
+void jumper_eachframe(struct Jumper *jmp);
+
 /*
 Returned rect can be used for drawing the jumper on screen.
 Usually it is highlighted only when the jumper is being pressed.
 */
-struct Rect3 jumper_eachframe(struct Jumper *jmp);
+struct Rect3 jumper_to_rect3(const struct Jumper *jmp);
 
-// May begin a jump by changing el->jumpstate
-void jumper_press(struct Jumper *jmp, struct Ellipsoid *el);
+// May begin a jump of the ellipsoid by changing its jump state
+void jumper_press(struct Jumper *jmp, const struct Ellipsoid *el, struct EllipsoidJumpState *js);
 
 #endif  // JUMPER_H
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
+#include "cachebench.h"
 #include "camera.h"
 #include "chooser.h"
 #include "enemy.h"
@@ -15,9 +16,15 @@
 #include "gameover.h"
 #include "misc.h"
 #include "player.h"
+#include "simulate.h"
+#include "snapshot.h"
 #include "sound.h"
 #include "log.h"
 #include "map.h"
+#include "max.h"
+#include "profiler.h"
+#include "recording.h"
+#include "showall.h"
 #include "mapeditor.h"
 #include "deletemap.h"
 
@@ -121,31 +128,139 @@ static void load_the_stuff(SDL_Window *wnd, bool sound)
 	jumper_init_global_images(wndsurf->format);
 }
 
+static int simulate_without_window(int ngames, const char *snapshotpath, int nplayers, bool huntingenemies)
+{
+	int nmaps;
+	struct Map *maps = map_list(&nmaps);
+	int ret = 0;
+
+	if (snapshotpath) {
+		struct GameState *gs = snapshot_load(snapshotpath, maps, nmaps);
+		if (gs) {
+			simulate_from_snapshot(gs, ngames);
+			gamestate_free(gs);
+		} else {
+			fprintf(stderr, "Cannot load \"%s\", see the log file for details\n", snapshotpath);
+			ret = 1;
+		}
+	} else {
+		simulate_games(maps, nmaps, ngames, nplayers, huntingenemies);
+	}
+
+	free(maps);
+	return ret;
+}
+
+/*
+Paths in the recording are relative to the directory where everything is, so
+this must run after cd_where_everything_is().
+*/
+static int replay(const char *path, bool headless, unsigned stopframe, SDL_Window *wnd)
+{
+	struct Recording *rec = recording_load(path);
+	if (!rec) {
+		fprintf(stderr, "Cannot load \"%s\", see the log file for details\n", path);
+		return 1;
+	}
+
+	int nmaps;
+	struct Map *maps = map_list(&nmaps);
+	const struct Map *map = recording_find_map(rec, maps, nmaps);
+	if (!map) {
+		fprintf(stderr, "The recording uses map \"%s\", but it doesn't exist\n", rec->mappath);
+		free(maps);
+		recording_free(rec);
+		return 1;
+	}
+
+	if (headless) {
+		simulate_replay(rec, map, stopframe);
+	} else {
+		const struct EllipsoidPic *plrpics[MAX_PLAYERS];
+		for (int i = 0; i < rec->nplayers; i++)
+			plrpics[i] = player_find_epic(rec->plrpicpaths[i]);
+		profiler_enable(true);
+		play_replay(wnd, rec, map, plrpics, stopframe);
+		profiler_dump(stdout);
+	}
+
+	free(maps);
+	recording_free(rec);
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
-	bool sound = true, fullscreen = false;
+	bool sound = true, fullscreen = false, headless = false, cachebench = false;
+	int simulate = 0, nplayers = 2;
+	int width = CAMERA_SCREEN_WIDTH, height = CAMERA_SCREEN_HEIGHT;
+	const char *replaypath = NULL, *snapshotpath = NULL;
+	unsigned stopframe = ~0u;
+
 	for (int i = 1; i < argc; i++) {
 		if (!strcmp(argv[i], "--no-sound"))
 			sound = false;
 		else if (!strcmp(argv[i], "--fullscreen"))
 			fullscreen = true;
+		else if (!strcmp(argv[i], "--size") && i+1 < argc
+				&& sscanf(argv[i+1], "%dx%d", &width, &height) == 2
+				&& width >= CAMERA_SCREEN_WIDTH && height >= CAMERA_SCREEN_HEIGHT)
+			i++;
+		else if (!strcmp(argv[i], "--simulate") && i+1 < argc && atoi(argv[i+1]) > 0)
+			simulate = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--players") && i+1 < argc && 2 <= atoi(argv[i+1]) && atoi(argv[i+1]) <= MAX_PLAYERS)
+			nplayers = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--replay") && i+1 < argc)
+			replaypath = argv[++i];
+		else if (!strcmp(argv[i], "--snapshot") && i+1 < argc)
+			snapshotpath = argv[++i];
+		else if (!strcmp(argv[i], "--headless"))
+			headless = true;
+		else if (!strcmp(argv[i], "--cache-benchmark"))
+			cachebench = true;
+		else if (!strcmp(argv[i], "--hunting-enemies"))
+			play_hunting_enemies = true;
+		else if (!strcmp(argv[i], "--fixed-quality"))
+			play_quality_governor = false;
+		else if (!strcmp(argv[i], "--check-draw-order"))
+			showall_crosscheck = true;
+		else if (!strcmp(argv[i], "--stop-at") && i+1 < argc && atoi(argv[i+1]) > 0)
+			stopframe = (unsigned)atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--draw-distance") && i+1 < argc && !strcmp(argv[i+1], "auto")) {
+			play_drawdistance = PLAY_DRAWDISTANCE_AUTO;
+			i++;
+		} else if (!strcmp(argv[i], "--draw-distance") && i+1 < argc && atof(argv[i+1]) > 0)
+			play_drawdistance = (float)atof(argv[++i]);
 		else {
-			fprintf(stderr, "Usage: %s [--no-sound] [--fullscreen]\n", argv[0]);
+			fprintf(stderr,
+				"Usage: %s [--no-sound] [--fullscreen] [--size WIDTHxHEIGHT] [--players 2|3|4] [--simulate NUMBER_OF_GAMES] [--snapshot FILE] [--hunting-enemies] [--draw-distance DISTANCE|auto] [--fixed-quality] [--check-draw-order]\n"
+				"       %s --replay FILE [--headless] [--stop-at FRAME] [--size WIDTHxHEIGHT] [--draw-distance DISTANCE|auto] [--fixed-quality] [--check-draw-order]\n"
+				"       %s --cache-benchmark\n",
+				argv[0], argv[0], argv[0]);
 			return 2;
 		}
 	}
 
 	cd_where_everything_is();
 	log_init();
+	srand(time(NULL));
+
+	if (cachebench) {
+		cachebench_run();
+		return 0;
+	}
+	if (simulate)
+		return simulate_without_window(simulate, snapshotpath, nplayers, play_hunting_enemies);
+	if (replaypath && headless)
+		return replay(replaypath, true, stopframe, NULL);
 
 	SDL_Window *wnd = SDL_CreateWindow(
-		"3D game experiment", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, CAMERA_SCREEN_WIDTH, CAMERA_SCREEN_HEIGHT, 0);
+		"3D game experiment", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, width, height, 0);
 	if (!wnd)
 		log_printf_abort("SDL_CreateWindow failed: %s", SDL_GetError());
 	if (fullscreen)
 		SDL_SetWindowFullscreen(wnd, SDL_WINDOW_FULLSCREEN);
 
-	srand(time(NULL));
 	if (TTF_Init() == -1)
 		log_printf_abort("TTF_Init failed: %s", TTF_GetError());
 
@@ -163,11 +278,28 @@ int main(int argc, char **argv)
 
 	load_the_stuff(wnd, sound);
 
+	if (replaypath) {
+		int ret = replay(replaypath, false, stopframe, wnd);
+		sound_deinit();
+		SDL_DestroyWindow(wnd);
+		SDL_Quit();
+		return ret;
+	}
+
 	struct Chooser ch;
 	chooser_init(&ch, wnd);
 	const struct EllipsoidPic *winner;
 	enum State s = STATE_CHOOSER;
 
+	if (snapshotpath) {
+		struct GameState *gs = snapshot_load(snapshotpath, ch.mapch.maps, ch.mapch.nmaps);
+		if (gs) {
+			log_printf("continuing the game from snapshot \"%s\"", snapshotpath);
+			s = play_from_snapshot(wnd, gs, &winner);
+			gamestate_free(gs);
+		}
+	}
+
 	while(1) {
 		switch(s) {
 		case STATE_CHOOSER:
@@ -177,10 +309,14 @@ int main(int argc, char **argv)
 
 		case STATE_PLAY:
 			log_printf(
-				"playing the game begins with map \"%s\"",
-				ch.mapch.maps[ch.mapch.listbox.selectidx].name);
+				"playing the game begins with map \"%s\", %d players",
+				ch.mapch.maps[ch.mapch.listbox.selectidx].name, nplayers);
+			// The chooser has only 2 players, others get pictures that nobody chose
+			const struct EllipsoidPic *plrpics[MAX_PLAYERS] = { ch.playerch[0].epic, ch.playerch[1].epic };
+			for (int i = 2; i < nplayers; i++)
+				plrpics[i] = player_find_unused_epic(plrpics, i);
 			s = play_the_game(
-				wnd, ch.playerch[0].epic, ch.playerch[1].epic, &winner,
+				wnd, plrpics, nplayers, &winner,
 				&ch.mapch.maps[ch.mapch.listbox.selectidx]);
 			break;
 
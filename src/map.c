@@ -142,7 +142,7 @@ static void parse_square_content(char c, struct SquareParsingState *st)
 	case ' ':
 		break;
 	case 'e':
-		SDL_assert(st->map->nenemylocs < MAX_ENEMIES);
+		SDL_assert(st->map->nenemylocs < MAX_ENEMYLOCS);
 		st->map->enemylocs[st->map->nenemylocs++] = st->loc;
 		break;
 	case 'j':
@@ -447,6 +447,17 @@ static bool point_is_available(const struct Map *map, const struct MapCoords p)
 	return true;
 }
 
+struct MapCoords map_findempty(const struct Map *map, struct MapCoords hint)
+{
+	struct MapCoords p = hint;
+	while (!point_is_available(map, p)) {
+		manhattan_spiral(&p, hint);
+		if (abs(p.x - hint.x) + abs(p.z - hint.z) > map->xsize + map->zsize)
+			return hint;   // map is full
+	}
+	return p;
+}
+
 static void fix_location(const struct Map *map, struct MapCoords *ptr)
 {
 	SDL_assert(2 + map->nenemylocs + map->njumpers <= map->xsize*map->zsize);
@@ -20,7 +20,7 @@ struct Map {
 	int copycount;
 
 	struct MapCoords playerlocs[2];
-	struct MapCoords enemylocs[MAX_ENEMIES];
+	struct MapCoords enemylocs[MAX_ENEMYLOCS];
 	int nenemylocs;
 	struct MapCoords jumperlocs[MAX_JUMPERS];
 	int njumpers;
@@ -13,10 +13,12 @@
 #include "max.h"
 #include "misc.h"
 #include "player.h"
+#include "prng.h"
 #include "rect3.h"
 #include "showall.h"
 #include "textentry.h"
 #include "wall.h"
+#include "wallgrid.h"
 
 struct EllipsoidEdit {
 	struct Ellipsoid el;
@@ -56,7 +58,7 @@ struct MapEditor {
 	enum State state;
 	struct Map *map;
 	struct EllipsoidEdit playeredits[2];
-	struct EllipsoidEdit enemyedits[MAX_ENEMIES];
+	struct EllipsoidEdit enemyedits[MAX_ENEMYLOCS];
 	struct Camera cam;
 	float zoom;
 	float campos;
@@ -185,18 +187,6 @@ static void keep_wall_within_map(const struct MapEditor *ed, struct Wall *w, boo
 	clamp(&w->startz, zmin, zmax);
 }
 
-static bool mouse_is_on_ellipsoid(const struct Camera *cam, const struct Ellipsoid *el, int x, int y)
-{
-	if (!ellipsoid_is_visible(el, cam))
-		return false;
-
-	int xmin, xmax;
-	SDL_Rect bbox = ellipsoid_bbox(el, cam);
-	return SDL_PointInRect(&(SDL_Point){x,y}, &bbox)
-		&& ellipsoid_xminmax(el, cam, y, &xmin, &xmax)
-		&& xmin <= x && x <= xmax;
-}
-
 static bool mouse_is_on_wall(const struct Camera *cam, const struct Wall *w, int x, int y)
 {
 	int xmin, xmax;
@@ -207,16 +197,30 @@ static bool mouse_is_on_wall(const struct Camera *cam, const struct Wall *w, int
 		&& xmin <= x && x <= xmax;
 }
 
-static bool mouse_is_on_ellipsoid_with_no_walls_between(struct MapEditor *ed, const struct Ellipsoid *el, int x, int y)
+/*
+static so that arrays don't need to be allocated again, and showing is fast
+when only some things changed. Works with many editors, because changed things
+are noticed.
+*/
+static struct ShowAllContext *showallctx = NULL;
+static const struct MapEditor *lastshown = NULL;   // editor whose objects are in id buffer of showallctx
+
+/*
+Ellipsoid that the mouse is on, as shown on screen. Doesn't find ellipsoids
+behind walls, because walls are drawn on top of them.
+*/
+static struct EllipsoidEdit *find_ellipsoid_under_mouse(struct MapEditor *ed, int x, int y)
 {
-	if (!mouse_is_on_ellipsoid(&ed->cam, el, x, y))
-		return false;
-
-	for (const struct Wall *w = ed->map->walls; w < &ed->map->walls[ed->map->nwalls]; w++) {
-		if (wall_side(w, ed->cam.location) != wall_side(w, el->center) && mouse_is_on_wall(&ed->cam, w, x, y))
-			return false;
-	}
-	return true;
+	int idx;
+	if (lastshown != ed || showall_object_at(showallctx, x, y, &idx) != SHOWALL_ELLIPSOID)
+		return NULL;
+
+	// show_editor() makes a span for each ellipsoid, in the order of next_ellipsoid_edit()
+	if (idx < 2)
+		return &ed->playeredits[idx];
+	if (idx - 2 < ed->map->nenemylocs)
+		return &ed->enemyedits[idx - 2];
+	return NULL;
 }
 
 static bool project_mouse_to_horizontal_plane(
@@ -271,19 +275,7 @@ static void select_by_mouse_coords(struct MapEditor *ed, int mousex, int mousey)
 	switch(ed->tool) {
 	case TOOL_ENEMY:
 	{
-		float smallestd = HUGE_VALF;
-		struct EllipsoidEdit *selected = NULL;
-
-		// Find ellipsoid visible with no walls between having smallest distance to camera
-		for (struct EllipsoidEdit *ee = NULL; next_ellipsoid_edit(ed, &ee); ) {
-			if (mouse_is_on_ellipsoid_with_no_walls_between(ed, &ee->el, mousex, mousey)) {
-				float d = vec3_lengthSQUARED(vec3_sub(ee->el.center, ed->cam.location));
-				if (d < smallestd) {
-					selected = ee;
-					smallestd = d;
-				}
-			}
-		}
+		struct EllipsoidEdit *selected = find_ellipsoid_under_mouse(ed, mousex, mousey);
 		if (selected) {
 			ed->sel = (struct Selection){ .mode = SEL_SQUARE, .data.square = *selected->loc };
 			return;
@@ -645,7 +637,7 @@ static bool on_mouse_or_enter_released(struct MapEditor *ed)
 
 	if (ed->tool == TOOL_ENEMY
 		&& ed->sel.mode == SEL_SQUARE
-		&& ed->map->nenemylocs < MAX_ENEMIES
+		&& ed->map->nenemylocs < MAX_ENEMYLOCS
 		&& !find_ellipsoid_or_jumper_for_square(ed, ed->sel.data.square))
 	{
 		ed->map->enemylocs[ed->map->nenemylocs++] = ed->sel.data.square;
@@ -853,15 +845,25 @@ static void show_editor(struct MapEditor *ed)
 			.z = ed->map->jumperlocs[i].z,
 			.highlight = square_should_be_highlighted(ed, ed->map->jumperlocs[i]),
 		};
-		rects[ed->map->nwalls + i] = jumper_eachframe(&tmp);
+		jumper_eachframe(&tmp);
+		rects[ed->map->nwalls + i] = jumper_to_rect3(&tmp);
 	}
 
-	struct Ellipsoid els[2 + MAX_ENEMIES];
-	int nels = 0;
+	struct EllipsoidSpan spans[2 + MAX_ENEMYLOCS];
+	int nspans = 0;
 	for (const struct EllipsoidEdit *ee = NULL; next_ellipsoid_edit_const(ed, &ee); )
-		els[nels++] = ee->el;
+		spans[nspans++] = (struct EllipsoidSpan){ &ee->el, 1 };
 
-	show_all(rects, ed->map->nwalls + ed->map->njumpers, els, nels, &ed->cam);
+	// static for the same reason as rects, and updating is fast when only some walls changed
+	static struct WallGrid grid;
+	wallgrid_update(&grid, rects, ed->map->nwalls);
+
+	if (!showallctx) {
+		showallctx = showall_context_new();
+		showall_enable_idbuffer(showallctx);
+	}
+	show_all(showallctx, rects, ed->map->nwalls + ed->map->njumpers, &grid, spans, nspans, &ed->cam);
+	lastshown = ed;
 
 	struct Wall *borderwall;
 	switch(ed->sel.mode) {
@@ -981,7 +983,7 @@ struct MapEditor *mapeditor_new(SDL_Surface *surf, int ytop, float zoom)
 				.scancodes = { SDL_SCANCODE_1 },
 				.destsurf = surf,
 				.center = {
-					CAMERA_SCREEN_WIDTH - button_width(BUTTON_THICK)/2,
+					surf->w - button_width(BUTTON_THICK)/2,
 					button_height(bf)/2
 				},
 				.onclick = on_wall_button_clicked,
@@ -993,7 +995,7 @@ struct MapEditor *mapeditor_new(SDL_Surface *surf, int ytop, float zoom)
 				.scancodes = { SDL_SCANCODE_2 },
 				.destsurf = surf,
 				.center = {
-					CAMERA_SCREEN_WIDTH - button_width(BUTTON_THICK)/2,
+					surf->w - button_width(BUTTON_THICK)/2,
 					button_height(bf)*3/2
 				},
 				.onclick = on_enemy_button_clicked,
@@ -1005,7 +1007,7 @@ struct MapEditor *mapeditor_new(SDL_Surface *surf, int ytop, float zoom)
 				.scancodes = { SDL_SCANCODE_3 },
 				.destsurf = surf,
 				.center = {
-					CAMERA_SCREEN_WIDTH - button_width(BUTTON_THICK)/2,
+					surf->w - button_width(BUTTON_THICK)/2,
 					button_height(bf)*5/2
 				},
 				.onclick = on_jumper_button_clicked,
@@ -1032,11 +1034,15 @@ struct MapEditor *mapeditor_new(SDL_Surface *surf, int ytop, float zoom)
 		ed->playeredits[p].el.center.y = PLAYER_YRADIUS_NOFLAT;
 		ellipsoid_update_transforms(&ed->playeredits[p].el);
 	}
+	// The editor isn't a game, it doesn't matter which pictures the enemies get
+	struct Prng prng;
+	prng_seed(&prng, (uint64_t)rand());
+
 	// Enemies and jumpers go all the way to max, so don't need to do again if add enemies
-	for (int i = 0; i < MAX_ENEMIES; i++) {
+	for (int i = 0; i < MAX_ENEMYLOCS; i++) {
 		ed->enemyedits[i].el.xzradius = ENEMY_XZRADIUS;
 		ed->enemyedits[i].el.yradius = ENEMY_YRADIUS,
-		ed->enemyedits[i].el.epic = enemy_getrandomepic();
+		ed->enemyedits[i].el.epic = enemy_getrandomepic(&prng);
 		ed->enemyedits[i].el.hidelowerhalf = true;
 		ellipsoid_update_transforms(&ed->enemyedits[i].el);
 	}
@@ -1053,6 +1059,8 @@ void mapeditor_setmap(struct MapEditor *ed, struct Map *map)
 	SDL_FillRect(ed->cam.surface, NULL, 0);
 
 	ed->map = map;
+	if (lastshown == ed)
+		lastshown = NULL;   // id buffer has the previous map
 	ed->campos = HUGE_VALF;
 	ed->posdir = 0;
 	ed->rotatedir = 0;
@@ -1067,7 +1075,7 @@ void mapeditor_setmap(struct MapEditor *ed, struct Map *map)
 
 	for (int p = 0; p < 2; p++)
 		ed->playeredits[p].loc = &map->playerlocs[p];
-	for (int i = 0; i < MAX_ENEMIES; i++)
+	for (int i = 0; i < MAX_ENEMYLOCS; i++)
 		ed->enemyedits[i].loc = &map->enemylocs[i];
 }
 
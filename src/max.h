@@ -4,19 +4,16 @@
 // the players can have INT_MAX picked guards or whatever, we display only some of them
 #define MAX_PICKED_GUARDS_TO_DISPLAY_PER_PLAYER 64
 
-#define MAX_UNPICKED_GUARDS 1024        // big max just for fun
-#define MAX_ENEMIES 256
-#define MAX_ELLIPSOIDS ( \
-	MAX_ENEMIES \
-	+ MAX_UNPICKED_GUARDS \
-	+ (\
-		1                                          /* player */ \
-		+ MAX_PICKED_GUARDS_TO_DISPLAY_PER_PLAYER  /* and his/her guards */ \
-	)*2                                            /* for both players */ \
-)
+// split screen gets too small with more players
+#define MAX_PLAYERS 4
 
+/*
+There's no max number of enemies or unpicked guards in a game, their arrays grow
+as needed. Things in maps have a max, because the map editor uses fixed arrays.
+*/
+#define MAX_ENEMYLOCS 256   // enemy spawning locations in a map
 #define MAX_MAPSIZE 30
-#define MAX_WALLS 1000
+#define MAX_WALLS (2*MAX_MAPSIZE*(MAX_MAPSIZE+1))   // all walls of the biggest possible map
 #define MAX_JUMPERS 15
 #define MAX_RECTS (MAX_WALLS + MAX_JUMPERS)
 
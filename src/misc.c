@@ -159,6 +159,72 @@ SDL_Surface *create_cropped_surface(SDL_Surface *surf, SDL_Rect r)
 }
 
 extern inline uint32_t rgb_average(uint32_t a, uint32_t b);
+extern inline uint32_t rgb_scale(uint32_t color, uint32_t brightness);
+
+void write_number(FILE *f, uint64_t value, int nbytes)
+{
+	for (int i = 0; i < nbytes; i++)
+		fputc((int)((value >> (8*i)) & 0xff), f);
+}
+
+bool read_number(FILE *f, uint64_t *value, int nbytes)
+{
+	*value = 0;
+	for (int i = 0; i < nbytes; i++) {
+		int c = fgetc(f);
+		if (c == EOF)
+			return false;
+		*value |= (uint64_t)c << (8*i);
+	}
+	return true;
+}
+
+void write_float(FILE *f, float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof bits);
+	write_number(f, bits, 4);
+}
+
+bool read_float(FILE *f, float *value)
+{
+	uint64_t bits;
+	if (!read_number(f, &bits, 4))
+		return false;
+	uint32_t bits32 = (uint32_t)bits;
+	memcpy(value, &bits32, sizeof bits32);
+	return true;
+}
+
+void write_string(FILE *f, const char *s)
+{
+	size_t len = strlen(s);
+	SDL_assert(len <= UINT16_MAX);
+	write_number(f, len, 2);
+	fwrite(s, 1, len, f);
+}
+
+bool read_string(FILE *f, char *buf, size_t bufsize)
+{
+	uint64_t len;
+	if (!read_number(f, &len, 2) || len >= bufsize || fread(buf, 1, len, f) != len)
+		return false;
+	buf[len] = '\0';
+	return true;
+}
+
+void *grow_array(void *arr, int *alloced, int n, size_t elemsize)
+{
+	if (n <= *alloced)
+		return arr;
+
+	int newalloced = max(n, 2 * *alloced);
+	void *res = realloc(arr, (size_t)newalloced * elemsize);
+	if (!res)
+		log_printf_abort("not enough memory for %d elements of size %d", newalloced, (int)elemsize);
+	*alloced = newalloced;
+	return res;
+}
 
 void basename_without_extension(const char *path, char *name, int sizeofname)
 {
@@ -3,7 +3,9 @@
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #define GRAVITY 66.0f
 
@@ -70,6 +72,31 @@ inline uint32_t rgb_average(uint32_t a, uint32_t b) {
 	return ((a & 0xfefefe) >> 1) + ((b & 0xfefefe) >> 1);
 }
 
+// brightness 0 gives black, 256 gives the color unchanged
+inline uint32_t rgb_scale(uint32_t color, uint32_t brightness) {
+	return ((((color & 0xff00ff) * brightness) >> 8) & 0xff00ff)
+		| ((((color & 0x00ff00) * brightness) >> 8) & 0x00ff00);
+}
+
+/*
+Little-endian numbers and floats, and strings with 2-byte length in front, for
+binary files (recordings and snapshots). The read functions return false on
+EOF, and read_string() also when the string doesn't fit.
+*/
+void write_number(FILE *f, uint64_t value, int nbytes);
+bool read_number(FILE *f, uint64_t *value, int nbytes);
+void write_float(FILE *f, float value);
+bool read_float(FILE *f, float *value);
+void write_string(FILE *f, const char *s);
+bool read_string(FILE *f, char *buf, size_t bufsize);
+
+/*
+Returns arr reallocated to have room for at least n elements, and updates
+*alloced. Grows to double size, so that adding one element at a time is fast.
+Contents are kept, new elements are not initialized. Aborts on out of memory.
+*/
+void *grow_array(void *arr, int *alloced, int n, size_t elemsize);
+
 // "bla/bla/file.txt" --> "file"
 void basename_without_extension(const char *path, char *name, int sizeofname);
 
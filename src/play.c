@@ -1,13 +1,15 @@
 #include "play.h"
-#include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <SDL2/SDL.h>
 #include "camera.h"
 #include "ellipsoid.h"
-#include "enemy.h"
+#include "gamestate.h"
+#include "governor.h"
 #include "guard.h"
 #include "jumper.h"
 #include "log.h"
@@ -17,114 +19,26 @@
 #include "misc.h"
 #include "pause.h"
 #include "player.h"
+#include "profiler.h"
+#include "recording.h"
 #include "rect3.h"
 #include "showall.h"
-#include "sound.h"
+#include "snapshot.h"
 #include "wall.h"
+#include "wallgrid.h"
 
-// includes all the GameObjects that all players should see
-struct GameState {
-	const struct Map *map;
-	const SDL_PixelFormat *pixfmt;
+float play_drawdistance = PLAY_DRAWDISTANCE_AUTO;
+bool play_hunting_enemies = false;
+bool play_quality_governor = true;
 
-	struct Player players[2];
-
-	struct Enemy enemies[MAX_ENEMIES];
-	int nenemies;
-
-	struct Ellipsoid unpicked_guards[MAX_UNPICKED_GUARDS];
-	int n_unpicked_guards;
-
-	unsigned thisframe;
-	unsigned lastenemyframe, lastguardframe;
-
-	struct Jumper jumpers[MAX_JUMPERS];
+// Where the keys come from, and where they go
+struct KeySource {
+	FILE *recfile;   // NULL if not recording
+	const struct Recording *replay;   // NULL if not replaying
+	int replayidx;
 };
 
-static bool time_to_do_something(unsigned *frameptr, unsigned thisframe, unsigned delay)
-{
-	// https://yarchive.net/comp/linux/unsigned_arithmetic.html
-	if (thisframe - *frameptr > delay) {
-		*frameptr += delay;
-		return true;
-	}
-	return false;
-}
-
-static void add_enemy(struct GameState *gs, const struct MapCoords *coordptr)
-{
-	if (gs->map->nenemylocs == 0) {  // avoid crash in "% 0" below
-		log_printf("map has no enemies");
-		return;
-	}
-
-	SDL_assert(gs->nenemies <= MAX_ENEMIES);
-	if (gs->nenemies == MAX_ENEMIES) {
-		log_printf("hitting MAX_ENEMIES=%d", MAX_ENEMIES);
-		return;
-	}
-
-	struct MapCoords pc;
-	if (coordptr)
-		pc = *coordptr;
-	else {
-		// Choose random enemy location.
-		// Does not take in account region size, otherwise small regions are too safe.
-		pc = gs->map->enemylocs[rand() % gs->map->nenemylocs];
-	}
-
-	gs->enemies[gs->nenemies++] = enemy_new(gs->map, pc);
-}
-
-// runs each frame
-static void add_guards_and_enemies_as_needed(struct GameState *gs)
-{
-	int n = 3;
-	float nprob = 0.2f;    // probability to get stack of n guards instead of 1 guard
-
-	/*
-	The frequency of enemies appearing, as enemies per frame on average, is
-
-		1/enemydelay,
-
-	because we get one enemy in enemydelay frames. The expected value of guards
-	to get (aka weighted average of guard counts with probabilities as weights) is
-
-		nprob*n + (1 - nprob)*1,
-
-	so the frequency of guards appearing is
-
-		(nprob*n + (1 - nprob)*1)/guarddelay.
-
-	If enemy and guard frequencies are equal, we have a balance of enemies and
-	guards. Setting the frequencies equal allows me to solve guarddelay given enemydelay.
-	We can still set enemydelay however we want.
-	*/
-	unsigned enemydelay = 5*CAMERA_FPS;
-	unsigned guarddelay = (unsigned)( (nprob*n + (1 - nprob)*1)*enemydelay );
-
-	/*
-	People make mistakes, and the enemies win eventually, even with the variables we have
-	now, but that can take a very long time.
-	Also make sure that small areas containing a spawning point are not too safe.
-	*/
-	enemydelay = (unsigned)(enemydelay * 0.6f);
-	if (gs->map->nenemylocs != 0)
-		enemydelay /= gs->map->nenemylocs;
-
-	gs->thisframe++;
-	if (time_to_do_something(&gs->lastguardframe, gs->thisframe, guarddelay)) {
-		int toadd = (rand() < (int)(nprob*(float)RAND_MAX)) ? n : 1;
-		log_printf("There are %d unpicked guards, adding %d more", gs->n_unpicked_guards, toadd);
-		guard_create_unpickeds_random(gs->unpicked_guards, &gs->n_unpicked_guards, toadd, gs->map);
-	}
-	if (time_to_do_something(&gs->lastenemyframe, gs->thisframe, enemydelay)) {
-		log_printf("There are %d enemies, adding one more", gs->nenemies);
-		add_enemy(gs, NULL);
-	}
-}
-
-static enum State handle_event(SDL_Event event, struct GameState *gs, SDL_Window *wnd)
+static enum State handle_event(SDL_Event event, struct GameState *gs, SDL_Window *wnd, struct KeySource *ks)
 {
 	bool down = (event.type == SDL_KEYDOWN);
 
@@ -134,30 +48,19 @@ static enum State handle_event(SDL_Event event, struct GameState *gs, SDL_Window
 
 	case SDL_KEYDOWN:
 	case SDL_KEYUP:
-		switch(normalize_scancode(event.key.keysym.scancode)) {
-			// many keyboards have numpad with zero right next to the "→" arrow, like "f" is next to "d"
-			case SDL_SCANCODE_F:
-				if (down) player_drop_guard(&gs->players[0], gs->unpicked_guards, &gs->n_unpicked_guards);
-				break;
-			case SDL_SCANCODE_0:
-				if (down) player_drop_guard(&gs->players[1], gs->unpicked_guards, &gs->n_unpicked_guards);
-				break;
-
-			case SDL_SCANCODE_A: player_set_turning(&gs->players[0], -1, down); break;
-			case SDL_SCANCODE_D: player_set_turning(&gs->players[0], +1, down); break;
-			case SDL_SCANCODE_W: player_set_moving(&gs->players[0], down); break;
-			case SDL_SCANCODE_S: player_set_flat(&gs->players[0], down); break;
-
-			case SDL_SCANCODE_LEFT: player_set_turning(&gs->players[1], -1, down); break;
-			case SDL_SCANCODE_RIGHT: player_set_turning(&gs->players[1], +1, down); break;
-			case SDL_SCANCODE_UP: player_set_moving(&gs->players[1], down); break;
-			case SDL_SCANCODE_DOWN: player_set_flat(&gs->players[1], down); break;
-
-			case SDL_SCANCODE_ESCAPE: return show_pause_screen(wnd);
-
-			default:
-				log_printf("unknown key press/release scancode %d", event.key.keysym.scancode);
+		if (event.key.keysym.scancode == SDL_SCANCODE_ESCAPE)
+			return show_pause_screen(wnd);
+		if (event.key.keysym.scancode == SDL_SCANCODE_F9) {
+			if (down)
+				snapshot_save(gs);
+			return STATE_PLAY;
 		}
+		if (ks->replay)   // players can only watch
+			return STATE_PLAY;
+		if (gamestate_handle_key(gs, event.key.keysym.scancode, down))
+			recording_add_key(ks->recfile, gs->thisframe, event.key.keysym.scancode, down);
+		else
+			log_printf("unknown key press/release scancode %d", event.key.keysym.scancode);
 		return STATE_PLAY;
 
 	default:
@@ -165,221 +68,361 @@ static enum State handle_event(SDL_Event event, struct GameState *gs, SDL_Window
 	}
 }
 
-static void handle_players_bumping_each_other(struct Player *plr0, struct Player *plr1)
+// Things needed only for drawing the game, too big to go on the stack
+struct DrawBuffers {
+	struct Rect3 rects[MAX_RECTS];
+	struct WallGrid wallgrid;
+	struct Ellipsoid pickedguards[MAX_PLAYERS][MAX_PICKED_GUARDS_TO_DISPLAY_PER_PLAYER];
+};
+
+// Returns number of spans. The spans point into gs and bufs, nothing is copied.
+static int get_ellipsoid_spans(const struct GameState *gs, struct DrawBuffers *bufs, int maxpicked, struct EllipsoidSpan *spans)
 {
-	float bump = ellipsoid_bump_amount(&plr0->ellipsoid, &plr1->ellipsoid);
-	if (bump != 0) {
-		log_printf("players bump into each other");
-		ellipsoid_move_apart(&plr0->ellipsoid, &plr1->ellipsoid, bump);
+	struct EllipsoidSpan *ptr = spans;
+	for (int p = 0; p < gs->nplayers; p++) {
+		// bottom guards first, so this hides the topmost guards
+		int npicked = min(guard_create_picked(bufs->pickedguards[p], &gs->players[p]), maxpicked);
+		*ptr++ = (struct EllipsoidSpan){ &gs->players[p].ellipsoid, 1 };
+		*ptr++ = (struct EllipsoidSpan){ bufs->pickedguards[p], npicked, true };
 	}
+	*ptr++ = (struct EllipsoidSpan){ gs->enemyels, gs->nenemies };
+	*ptr++ = (struct EllipsoidSpan){ gs->unpicked_guards.els, gs->unpicked_guards.n };
+	return ptr - spans;
 }
 
-static void handle_players_bumping_enemies(struct GameState *gs)
+/*
+Below full resolution, the player's camera draws to a smaller surface, and it
+is then stretched to the player's part of the window.
+*/
+static void set_resolution(struct Player *plr, SDL_Surface *windowpart, SDL_Surface **smallsurf, float resolution)
 {
-	for (int p = 0; p < 2; p++) {
-		for (int e = gs->nenemies - 1; e >= 0; e--) {
-			if (ellipsoid_bump_amount(&gs->players[p].ellipsoid, &gs->enemies[e].ellipsoid) != 0) {
-				log_printf(
-					"enemy %d/%d hits player %d (%d guards)",
-					e, gs->nenemies,
-					p, gs->players[p].nguards);
-				sound_play("farts/fart*.wav");
-				int nguards = --gs->players[p].nguards;   // can become negative
-
-				/*
-				If the game is over, then don't delete the enemy. This way it
-				shows up in game over screen.
-				*/
-				if (nguards >= 0)
-					gs->enemies[e] = gs->enemies[--gs->nenemies];
-			}
-		}
+	if (*smallsurf)
+		SDL_FreeSurface(*smallsurf);
+	*smallsurf = NULL;
+
+	if (resolution < 1) {
+		*smallsurf = SDL_CreateRGBSurfaceWithFormat(
+			0, (int)((float)windowpart->w*resolution), (int)((float)windowpart->h*resolution),
+			32, windowpart->format->format);
+		if (!*smallsurf)
+			log_printf_abort("SDL_CreateRGBSurfaceWithFormat failed: %s", SDL_GetError());
 	}
+
+	plr->cam.surface = *smallsurf ? *smallsurf : windowpart;
+	plr->cam.screencentery = plr->cam.surface->h/4;
+	plr->cam.resolution = resolution;
 }
 
-static void handle_enemies_bumping_unpicked_guards(struct GameState *gs)
+// With 2 players, the window is split into left and right. Otherwise it's 2x2.
+static SDL_Rect get_window_part(const SDL_Surface *winsurf, int nplayers, int i)
 {
-	for (int e = gs->nenemies - 1; e >= 0; e--) {
-		for (int u = gs->n_unpicked_guards - 1; u >= 0; u--) {
-			if (ellipsoid_bump_amount(&gs->enemies[e].ellipsoid, &gs->unpicked_guards[u]) != 0) {
-				log_printf("enemy %d/%d destroys unpicked guard %d/%d",
-					e, gs->nenemies, u, gs->n_unpicked_guards);
-				sound_play("farts/fart*.wav");
-				gs->unpicked_guards[u] = gs->unpicked_guards[--gs->n_unpicked_guards];
-			}
-		}
-	}
+	int w = winsurf->w/2;
+	if (nplayers == 2)
+		return (SDL_Rect){ i*w, 0, w, winsurf->h };
+	int h = winsurf->h/2;
+	return (SDL_Rect){ (i%2)*w, (i/2)*h, w, h };
 }
 
-static void handle_players_bumping_unpicked_guards(struct GameState *gs)
+// Drawing what one player sees
+struct CameraJob {
+	struct ShowAllContext *ctx;
+	const struct ShowAllWorld *world;
+	const struct Camera *cam;
+	SDL_Surface *smallsurf;   // NULL at full resolution
+	SDL_Surface *windowpart;
+};
+
+static void draw_camera(const struct CameraJob *job)
 {
-	for (int p = 0; p < 2; p++) {
-		for (int u = gs->n_unpicked_guards - 1; u >= 0; u--) {
-			if (ellipsoid_bump_amount(&gs->players[p].ellipsoid, &gs->unpicked_guards[u]) != 0) {
-				log_printf(
-					"player %d (%d guards) picks unpicked guard %d/%d",
-					p, gs->players[p].nguards, u, gs->n_unpicked_guards);
-				sound_play("pick.wav");
-				gs->unpicked_guards[u] = gs->unpicked_guards[--gs->n_unpicked_guards];
-				gs->players[p].nguards++;
-			}
-		}
+	if (job->smallsurf)
+		SDL_FillRect(job->smallsurf, NULL, 0);
+
+	uint64_t start = profiler_start();
+	showall_draw(job->ctx, job->world, job->cam);
+	profiler_stop("show_all", start);
+
+	if (job->smallsurf) {
+		// SDL_BlitScaled() uses nearest neighbour, which is fast
+		start = profiler_start();
+		SDL_BlitScaled(job->smallsurf, NULL, job->windowpart, NULL);
+		profiler_stop("stretching to window", start);
 	}
 }
 
-static int get_all_ellipsoids(
-	const struct GameState *gs, const struct Ellipsoid **arr)
-{
-	static struct Ellipsoid result[MAX_ELLIPSOIDS];
-	static_assert(sizeof(result[0]) < 512,
-		"Ellipsoid struct is huge, maybe switch to pointers?");
-	struct Ellipsoid *ptr = result;
-
-	*ptr++ = gs->players[0].ellipsoid;
-	*ptr++ = gs->players[1].ellipsoid;
-	ptr += guard_create_picked(ptr, &gs->players[0]);
-	ptr += guard_create_picked(ptr, &gs->players[1]);
+/*
+Cameras don't share anything they write to, and each player has a separate part
+of the window, so they can draw in parallel. The main thread draws for player 0,
+and other players have a thread that runs during the whole game. Creating
+threads for each frame would be slow.
+*/
+struct CameraWorker {
+	SDL_Thread *thread;   // NULL if creating the thread failed
+	SDL_sem *start;   // posted when job is ready to be drawn
+	SDL_sem *done;    // posted when job has been drawn
+	struct CameraJob job;
+	bool quit;
+};
 
-	for (int i = 0; i < gs->nenemies; i++)
-		*ptr++ = gs->enemies[i].ellipsoid;
+static int camera_worker_thread(void *workerptr)
+{
+	struct CameraWorker *w = workerptr;
+	while(1) {
+		SDL_SemWait(w->start);
+		if (w->quit)
+			return 0;
+		draw_camera(&w->job);
+		SDL_SemPost(w->done);
+	}
+}
 
-	// this will likely optimize into a memcpy, so why bother write it as memcpy :D
-	for (int i = 0; i < gs->n_unpicked_guards; i++)
-		*ptr++ = gs->unpicked_guards[i];
+static void start_camera_workers(struct CameraWorker *workers, int n)
+{
+	for (int i = 0; i < n; i++) {
+		struct CameraWorker *w = &workers[i];
+		*w = (struct CameraWorker){0};
+		w->start = SDL_CreateSemaphore(0);
+		w->done = SDL_CreateSemaphore(0);
+		if (w->start && w->done)
+			w->thread = SDL_CreateThread(camera_worker_thread, "camera", w);
+		if (!w->thread)
+			log_printf("creating camera thread failed, drawing in main thread: %s", SDL_GetError());
+	}
+}
 
-	SDL_assert(ptr < result + sizeof(result)/sizeof(result[0]));
+static void stop_camera_workers(struct CameraWorker *workers, int n)
+{
+	for (int i = 0; i < n; i++) {
+		struct CameraWorker *w = &workers[i];
+		if (w->thread) {
+			w->quit = true;
+			SDL_SemPost(w->start);
+			SDL_WaitThread(w->thread, NULL);
+		}
+		if (w->start)
+			SDL_DestroySemaphore(w->start);
+		if (w->done)
+			SDL_DestroySemaphore(w->done);
+	}
+}
 
-	*arr = result;
-	return ptr - result;
+// workers[i] draws jobs[i+1]
+static void draw_all_cameras(struct CameraWorker *workers, const struct CameraJob *jobs, int njobs)
+{
+	for (int i = 1; i < njobs; i++) {
+		if (workers[i-1].thread) {
+			workers[i-1].job = jobs[i];
+			SDL_SemPost(workers[i-1].start);
+		}
+	}
+	draw_camera(&jobs[0]);
+	for (int i = 1; i < njobs; i++) {
+		if (workers[i-1].thread)
+			SDL_SemWait(workers[i-1].done);
+		else
+			draw_camera(&jobs[i]);
+	}
 }
 
-enum State play_the_game(
-	SDL_Window *wnd,
-	const struct EllipsoidPic *plr0pic, const struct EllipsoidPic *plr1pic,
-	const struct EllipsoidPic **winnerpic,
-	const struct Map *map)
+/*
+Runs until the game ends, or until frame number stopframe when replaying.
+Returns STATE_GAMEOVER when the game ends.
+*/
+static enum State run_game(SDL_Window *wnd, struct GameState *gs, struct KeySource *ks, unsigned stopframe)
 {
 	SDL_Surface *winsurf = SDL_GetWindowSurface(wnd);
 	if (!winsurf)
 		log_printf_abort("SDL_GetWindowSurface failed: %s", SDL_GetError());
 
-	static struct GameState gs;   // static because its big struct, avoiding stack usage
-	gs = (struct GameState){
-		.nenemies = 0,
-		.map = map,
-		.pixfmt = winsurf->format,
-		.players = {
-			{
-				.ellipsoid = {
-					.angle = 0,
-					.epic = plr0pic,
-					.center = { map->playerlocs[0].x + 0.5f, 0, map->playerlocs[0].z + 0.5f },
-				},
-				.cam = {
-					.screencentery = winsurf->h/4,
-					.surface = create_cropped_surface(
-						winsurf, (SDL_Rect){ 0, 0, winsurf->w/2, winsurf->h }
-					),
-				},
-			},
-			{
-				.ellipsoid = {
-					.angle = 0,
-					.epic = plr1pic,
-					.center = { map->playerlocs[1].x + 0.5f, 0, map->playerlocs[1].z + 0.5f }
-				},
-				.cam = {
-					.screencentery = winsurf->h/4,
-					.surface = create_cropped_surface(
-						winsurf, (SDL_Rect){ winsurf->w/2, 0, winsurf->w/2, winsurf->h }
-					),
-				},
-			},
-		},
-	};
-	for (int i = 0; i < map->nenemylocs; i++)
-		add_enemy(&gs, &map->enemylocs[i]);
-
-	static struct Rect3 rects[MAX_RECTS];
+	const struct Map *map = gs->map;
+	struct Governor gov = {0};
+	struct Quality quality = governor_quality(&gov);
+	int nplayers = gs->nplayers;
+	SDL_Surface *windowparts[MAX_PLAYERS];
+	SDL_Surface *smallsurfs[MAX_PLAYERS] = {0};
+	struct ShowAllContext *showallctx[MAX_PLAYERS];
+	for (int i = 0; i < nplayers; i++) {
+		windowparts[i] = create_cropped_surface(winsurf, get_window_part(winsurf, nplayers, i));
+		set_resolution(&gs->players[i], windowparts[i], &smallsurfs[i], quality.resolution);
+		showallctx[i] = showall_context_new();
+	}
+
+	// calloc because an empty WallGrid is all zeros
+	struct DrawBuffers *bufs = calloc(1, sizeof(*bufs));
+	if (!bufs)
+		log_printf_abort("not enough memory");
+
 	for (int i = 0; i < map->nwalls; i++)
-		rects[i] = wall_to_rect3(&map->walls[i]);
-	struct Rect3 *jrectptr = &rects[map->nwalls];
+		bufs->rects[i] = wall_to_rect3(&map->walls[i]);
+	wallgrid_update(&bufs->wallgrid, bufs->rects, map->nwalls);
+	struct Rect3 *jrectptr = &bufs->rects[map->nwalls];
+	struct ShowAllWorld *world = showall_world_new();
+	struct CameraWorker workers[MAX_PLAYERS - 1];
+	start_camera_workers(workers, nplayers - 1);
 
-	for (int i = 0; i < map->njumpers; i++)
-		gs.jumpers[i] = (struct Jumper){
-			.x = map->jumperlocs[i].x,
-			.z = map->jumperlocs[i].z,
-		};
+	float frameseconds = 0;
 
 	struct LoopTimer lt = {0};
 	enum State ret;
 
-	while(gs.players[0].nguards >= 0 && gs.players[1].nguards >= 0) {
+	while(gamestate_winner(gs) == -1) {
+		if (ks->replay && gs->thisframe >= stopframe) {
+			ret = STATE_QUIT;
+			goto out;
+		}
+
 		SDL_Event e;
 		while(SDL_PollEvent(&e)) {
-			ret = handle_event(e, &gs, wnd);
+			ret = handle_event(e, gs, wnd, ks);
 			if (ret != STATE_PLAY)
 				goto out;
 		}
-
-		add_guards_and_enemies_as_needed(&gs);
-		for (int i = 0; i < gs.n_unpicked_guards; i++)
-			guard_unpicked_eachframe(&gs.unpicked_guards[i]);
-		for (int i = 0; i < gs.nenemies; i++) {
-			enemy_eachframe(&gs.enemies[i], gs.map);
-			for (int k = 0; k < map->njumpers; k++)
-				jumper_press(&gs.jumpers[k], &gs.enemies[i].ellipsoid);
+		if (ks->replay)
+			recording_apply_keys(ks->replay, gs, &ks->replayidx);
+
+		uint64_t framecounter = SDL_GetPerformanceCounter();
+		if (play_quality_governor && frameseconds > 0 && governor_update(&gov, frameseconds)) {
+			float oldres = quality.resolution;
+			quality = governor_quality(&gov);
+			if (quality.resolution != oldres) {
+				for (int i = 0; i < nplayers; i++) {
+					set_resolution(&gs->players[i], windowparts[i], &smallsurfs[i], quality.resolution);
+					// everything is in different place on the surface
+					showall_context_free(showallctx[i]);
+					showallctx[i] = showall_context_new();
+				}
+			}
 		}
-		for (int i = 0; i < 2; i++) {
-			player_eachframe(&gs.players[i], map);
-			for (int k = 0; k < map->njumpers; k++)
-				jumper_press(&gs.jumpers[k], &gs.players[i].ellipsoid);
+
+		// gamestate_eachframe() updates camera caches
+		for (int i = 0; i < nplayers; i++) {
+			if (play_drawdistance == PLAY_DRAWDISTANCE_AUTO)
+				gs->players[i].cam.drawdistance = quality.drawdistance;
+			else
+				gs->players[i].cam.drawdistance = play_drawdistance;
+			gs->players[i].cam.lodbias = quality.lodbias;
 		}
-		for (int i = 0; i < map->njumpers; i++)
-			jrectptr[i] = jumper_eachframe(&gs.jumpers[i]);
 
-		handle_players_bumping_each_other(&gs.players[0], &gs.players[1]);
-		handle_players_bumping_enemies(&gs);
-		handle_enemies_bumping_unpicked_guards(&gs);
-		handle_players_bumping_unpicked_guards(&gs);
+		uint64_t framestart = profiler_start();
+		uint64_t start = framestart;
+		gamestate_eachframe(gs);
+		for (int i = 0; i < map->njumpers; i++)
+			jrectptr[i] = jumper_to_rect3(&gs->jumpers[i]);
+		profiler_stop("game logic", start);
 
 		SDL_FillRect(winsurf, NULL, 0);
 
-		const struct Ellipsoid *els;
-		int nels = get_all_ellipsoids(&gs, &els);
-
-		for (int i = 0; i < 2; i++)
-			show_all(rects, map->nwalls + map->njumpers, els, nels, &gs.players[i].cam);
-
-		// horizontal line
-		SDL_FillRect(winsurf, &(SDL_Rect){ winsurf->w/2, 0, 1, winsurf->h }, SDL_MapRGB(winsurf->format, 0xff, 0xff, 0xff));
+		struct EllipsoidSpan spans[2*MAX_PLAYERS + 2];   // player and picked guards of each player, enemies, unpicked guards
+		int nspans = get_ellipsoid_spans(gs, bufs, quality.maxpickedguards, spans);
+		start = profiler_start();
+		showall_world_update(world, bufs->rects, map->nwalls + map->njumpers, &bufs->wallgrid, spans, nspans);
+		profiler_stop("show_all world", start);
+
+		struct CameraJob jobs[MAX_PLAYERS];
+		for (int i = 0; i < nplayers; i++)
+			jobs[i] = (struct CameraJob){ showallctx[i], world, &gs->players[i].cam, smallsurfs[i], windowparts[i] };
+		start = profiler_start();
+		draw_all_cameras(workers, jobs, nplayers);
+		profiler_stop("drawing all cameras", start);
+
+		// lines between players
+		uint32_t white = SDL_MapRGB(winsurf->format, 0xff, 0xff, 0xff);
+		SDL_FillRect(winsurf, &(SDL_Rect){ winsurf->w/2, 0, 1, winsurf->h }, white);
+		if (nplayers > 2)
+			SDL_FillRect(winsurf, &(SDL_Rect){ 0, winsurf->h/2, winsurf->w, 1 }, white);
 
 		char s[100];
-		if (gs.nenemies == 1)
+		if (gs->nenemies == 1)
 			strcpy(s, "1 enemy");
 		else
-			sprintf(s, "%d enemies", gs.nenemies);
-		if (gs.n_unpicked_guards == 1)
+			sprintf(s, "%d enemies", gs->nenemies);
+		if (gs->unpicked_guards.n == 1)
 			strcat(s, ", 1 unpicked guard");
 		else
-			sprintf(s+strlen(s), ", %d unpicked guards", gs.n_unpicked_guards);
+			sprintf(s+strlen(s), ", %d unpicked guards", gs->unpicked_guards.n);
+		if (gov.level > 0)
+			sprintf(s+strlen(s), ", quality level %d/%d", gov.level, GOVERNOR_NLEVELS-1);
 
 		SDL_Surface *surf = create_text_surface(s, (SDL_Color){0xff,0xff,0xff}, 20);
 		SDL_BlitSurface(surf, NULL, winsurf, &(SDL_Rect){20,10});
 		SDL_FreeSurface(surf);
 
+		// What the governor made worse, on a separate line because it's long
+		if (gov.level > 0) {
+			char desc[200];
+			governor_describe(&gov, desc, sizeof desc);
+			surf = create_text_surface(desc, (SDL_Color){0xff,0xff,0xff}, 16);
+			SDL_BlitSurface(surf, NULL, winsurf, &(SDL_Rect){20,35});
+			SDL_FreeSurface(surf);
+		}
+
+		start = profiler_start();
 		SDL_UpdateWindowSurface(wnd);
+		profiler_stop("SDL_UpdateWindowSurface", start);
+		profiler_stop("whole frame", framestart);
+		frameseconds = (float)(SDL_GetPerformanceCounter() - framecounter) / (float)SDL_GetPerformanceFrequency();
+
 		looptimer_wait(&lt);
 	}
 	ret = STATE_GAMEOVER;
 
-	if (gs.players[0].nguards >= 0)
-		*winnerpic = plr0pic;
-	else
-		*winnerpic = plr1pic;
-
 out:
-	SDL_FreeSurface(gs.players[0].cam.surface);
-	SDL_FreeSurface(gs.players[1].cam.surface);
+	stop_camera_workers(workers, nplayers - 1);
+	for (int i = 0; i < nplayers; i++) {
+		SDL_FreeSurface(windowparts[i]);
+		if (smallsurfs[i])
+			SDL_FreeSurface(smallsurfs[i]);
+		gs->players[i].cam.surface = NULL;
+		showall_context_free(showallctx[i]);
+	}
+	showall_world_free(world);
+	free(bufs);
+	return ret;
+}
+
+enum State play_the_game(
+	SDL_Window *wnd,
+	const struct EllipsoidPic *const *plrpics, int nplayers,
+	const struct EllipsoidPic **winnerpic,
+	const struct Map *map)
+{
+	uint64_t seed = ((uint64_t)time(NULL) << 32) ^ SDL_GetPerformanceCounter();
+	log_printf("random seed for the game: %llu", (unsigned long long)seed);
+
+	struct GameState *gs = gamestate_new(map, plrpics, nplayers, seed, play_hunting_enemies);
+	struct KeySource ks = { .recfile = recording_create(gs, seed) };
+
+	enum State ret = run_game(wnd, gs, &ks, 0);
+	recording_finish(ks.recfile, gs->thisframe);
+	if (ret == STATE_GAMEOVER)
+		*winnerpic = gs->players[gamestate_winner(gs)].ellipsoid.epic;
+
+	gamestate_free(gs);
+	return ret;
+}
+
+enum State play_from_snapshot(
+	SDL_Window *wnd, struct GameState *gs, const struct EllipsoidPic **winnerpic)
+{
+	// no recording, because recordings must start from the beginning of the game
+	struct KeySource ks = {0};
+	enum State ret = run_game(wnd, gs, &ks, 0);
+	if (ret == STATE_GAMEOVER)
+		*winnerpic = gs->players[gamestate_winner(gs)].ellipsoid.epic;
 	return ret;
 }
+
+void play_replay(
+	SDL_Window *wnd, const struct Recording *rec, const struct Map *map,
+	const struct EllipsoidPic *const *plrpics, unsigned stopframe)
+{
+	struct GameState *gs = gamestate_new(map, plrpics, rec->nplayers, rec->seed, rec->huntingenemies);
+	struct KeySource ks = { .replay = rec };
+
+	enum State ret = run_game(wnd, gs, &ks, stopframe);
+	if (ret == STATE_GAMEOVER)
+		log_printf("replay ended at frame %u, player %d won", gs->thisframe, gamestate_winner(gs));
+	else
+		log_printf("replay stopped at frame %u", gs->thisframe);
+
+	gamestate_free(gs);
+}
@@ -3,17 +3,49 @@
 #ifndef PLAY_H
 #define PLAY_H
 
+#include <stdbool.h>
 #include <SDL2/SDL.h>
 #include "ellipsoid.h"
+#include "gamestate.h"
 #include "misc.h"
 #include "map.h"
+#include "recording.h"
 
-// sets winnerpic when returns STATE_GAMEOVER
+/*
+How far the players can see, 0 means no limit (see struct Camera). The default
+is PLAY_DRAWDISTANCE_AUTO, which means that the quality governor decides, so
+there's no limit unless the game lags.
+*/
+#define PLAY_DRAWDISTANCE_AUTO (-1.0f)
+extern float play_drawdistance;
+
+// For new games, see flowfield.h. Replays and snapshots remember it.
+extern bool play_hunting_enemies;
+
+// Make drawing faster when the game lags, see governor.h
+extern bool play_quality_governor;
+
+/*
+Each player gets a part of the window, with 2 to MAX_PLAYERS players. Sets
+winnerpic when returns STATE_GAMEOVER.
+*/
 enum State play_the_game(
 	SDL_Window *wnd,
-	const struct EllipsoidPic *plr0pic, const struct EllipsoidPic *plr1pic,
+	const struct EllipsoidPic *const *plrpics, int nplayers,
 	const struct EllipsoidPic **winnerpic,
 	const struct Map *map);
 
+// Continues a game loaded with snapshot_load(). Doesn't free the game state.
+enum State play_from_snapshot(
+	SDL_Window *wnd, struct GameState *gs, const struct EllipsoidPic **winnerpic);
+
+/*
+Shows a recorded game at normal speed. Keyboard is ignored, except for pausing
+and quitting. Stops when the game ends, or at frame number stopframe.
+*/
+void play_replay(
+	SDL_Window *wnd, const struct Recording *rec, const struct Map *map,
+	const struct EllipsoidPic *const *plrpics, unsigned stopframe);
+
 
 #endif   // PLAY_H
@@ -1,5 +1,6 @@
 #include "player.h"
 #include <stddef.h>
+#include <string.h>
 #include <SDL2/SDL.h>
 #include "ellipsoid.h"
 #include "guard.h"
@@ -41,6 +42,30 @@ void player_init_epics(
 	SDL_assert(player_epics != NULL);
 }
 
+const struct EllipsoidPic *player_find_epic(const char *path)
+{
+	if (!player_epics)
+		return NULL;
+	for (int i = 0; i < player_nepics; i++) {
+		if (!strcmp(player_epics[i]->path, path))
+			return player_epics[i];
+	}
+	log_printf("player picture \"%s\" not found, using \"%s\" instead", path, player_epics[0]->path);
+	return player_epics[0];
+}
+
+const struct EllipsoidPic *player_find_unused_epic(const struct EllipsoidPic *const *used, int nused)
+{
+	for (int i = 0; i < player_nepics; i++) {
+		bool found = false;
+		for (int k = 0; k < nused; k++)
+			found = found || (used[k] == player_epics[i]);
+		if (!found)
+			return player_epics[i];
+	}
+	return player_epics ? player_epics[0] : NULL;
+}
+
 static float get_y_radius(const struct Player *plr)
 {
 	if (plr->flat)   // if flat and jumping, then do this
@@ -57,7 +82,7 @@ static void keep_ellipsoid_inside_map(struct Ellipsoid *el, const struct Map *ma
 void player_eachframe(struct Player *plr, const struct Map *map)
 {
 	// A bit unnecessary to do these each frame, but works
-	plr->ellipsoid.jumpstate.xzspeed = NORMAL_SPEED;
+	plr->jumpstate.xzspeed = NORMAL_SPEED;
 	plr->ellipsoid.xzradius = PLAYER_XZRADIUS;
 
 	// Don't turn while flat. See beginning of this file for explanation.
@@ -66,8 +91,8 @@ void player_eachframe(struct Player *plr, const struct Map *map)
 		// ellipsoid_update_transforms() called below
 	}
 
-	if (plr->ellipsoid.jumpstate.jumping) {
-		ellipsoid_jumping_eachframe(&plr->ellipsoid, map);
+	if (plr->jumpstate.jumping) {
+		ellipsoid_jumping_eachframe(&plr->ellipsoid, &plr->jumpstate, map);
 
 		plr->ellipsoid.yradius = get_y_radius(plr);
 		ellipsoid_update_transforms(&plr->ellipsoid);
@@ -148,7 +173,7 @@ void player_set_flat(struct Player *plr, bool flat)
 	}
 }
 
-void player_drop_guard(struct Player *plr, struct Ellipsoid *arr, int *arrlen)
+void player_drop_guard(struct Player *plr, struct UnpickedGuards *ug)
 {
 	if (plr->nguards <= 0)
 		return;
@@ -158,8 +183,7 @@ void player_drop_guard(struct Player *plr, struct Ellipsoid *arr, int *arrlen)
 	vec3_apply_matrix(&dropdiff, plr->cam.cam2world);
 	Vec3 loc = vec3_add(plr->ellipsoid.center, dropdiff);
 
-	int n = guard_create_unpickeds_center(arr, arrlen, 1, loc);
-	plr->nguards -= n;
-	if (n != 0)
-		sound_play("leave.wav");
+	guard_create_unpickeds_center(ug, 1, loc);
+	plr->nguards--;
+	sound_play("leave.wav");
 }
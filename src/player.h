@@ -24,6 +24,7 @@ walls. If you set xzradius to >0.25, then check that this doesn't happen.
 
 struct Player {
 	struct Ellipsoid ellipsoid;
+	struct EllipsoidJumpState jumpstate;
 	struct Camera cam;
 
 	int turning;   // see player_set_turning()
@@ -41,6 +42,12 @@ void player_init_epics(
 	const SDL_PixelFormat *fmt,
 	void (*progresscb)(void *cbdata, int i, int count), void *cbdata);
 
+// Returns some other picture if path not found, and NULL if pictures aren't loaded
+const struct EllipsoidPic *player_find_epic(const char *path);
+
+// For players that don't get to choose, returns a picture that isn't in used array if possible
+const struct EllipsoidPic *player_find_unused_epic(const struct EllipsoidPic *const *used, int nused);
+
 // run before showing stuff to user
 void player_eachframe(struct Player *plr, const struct Map *map);
 
@@ -52,10 +59,9 @@ void player_set_flat(struct Player *plr, bool flat);
 /*
 If the player has picked up guards and is moving, leave one behind the players
 so that others can get it.
-
-The array never becomes longer than MAX_UNPICKED_GUARDS.
 */
-void player_drop_guard(struct Player *plr, struct Ellipsoid *arr, int *arrlen);
+struct UnpickedGuards;  // defined in guard.h, which includes this file
+void player_drop_guard(struct Player *plr, struct UnpickedGuards *ug);
 
 
 #endif   // PLAYER_H
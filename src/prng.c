@@ -0,0 +1,52 @@
+#include "prng.h"
+#include <stdint.h>
+#include <SDL2/SDL.h>
+
+static uint64_t rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t splitmix64(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+	return z ^ (z >> 31);
+}
+
+void prng_seed(struct Prng *prng, uint64_t seed)
+{
+	// splitmix64 never gives all zeros, which is the one state that xoshiro can't use
+	for (int i = 0; i < 4; i++)
+		prng->s[i] = splitmix64(&seed);
+}
+
+uint64_t prng_next(struct Prng *prng)
+{
+	uint64_t *s = prng->s;
+	uint64_t result = rotl(s[1] * 5, 7) * 9;
+	uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+
+	return result;
+}
+
+int prng_int(struct Prng *prng, int n)
+{
+	SDL_assert(n > 0);
+	// upper bits are the best bits, and n is small so modulo bias doesn't matter
+	return (int)((prng_next(prng) >> 32) % (uint64_t)n);
+}
+
+float prng_float(struct Prng *prng)
+{
+	// 24 bits is exactly what a float can represent
+	return (float)(prng_next(prng) >> 40) / (float)(1 << 24);
+}
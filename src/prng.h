@@ -0,0 +1,27 @@
+/*
+Pseudo-random numbers without global state. Each game has its own Prng, so the
+same seed always gives the same game, and many games can run at the same time
+in different threads.
+
+This is xoshiro256** seeded with splitmix64, see https://prng.di.unimi.it/
+*/
+
+#ifndef PRNG_H
+#define PRNG_H
+
+#include <stdint.h>
+
+struct Prng {
+	uint64_t s[4];
+};
+
+void prng_seed(struct Prng *prng, uint64_t seed);
+uint64_t prng_next(struct Prng *prng);
+
+// Returns integer between 0 and n-1
+int prng_int(struct Prng *prng, int n);
+
+// Returns float between 0 and 1, never exactly 1
+float prng_float(struct Prng *prng);
+
+#endif   // PRNG_H
@@ -0,0 +1,105 @@
+#include "profiler.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "log.h"
+
+#define MAX_ENTRIES 64
+
+struct ProfilerEntry {
+	const char *name;
+	bool istime;    // false for profiler_count()
+	uint64_t ncalls;
+	uint64_t total, max;   // performance counter ticks, or counts
+};
+
+// Mutable global state, but this is only for measuring performance, so it's fine
+static bool enabled = false;
+static SDL_SpinLock lock = 0;
+static struct ProfilerEntry entries[MAX_ENTRIES];
+static int nentries = 0;
+
+void profiler_enable(bool enable)
+{
+	enabled = enable;
+}
+
+uint64_t profiler_start(void)
+{
+	return enabled ? SDL_GetPerformanceCounter() : 0;
+}
+
+// call with lock held
+static struct ProfilerEntry *find_entry(const char *name, bool istime)
+{
+	for (int i = 0; i < nentries; i++) {
+		// usually names are the same string literal, so comparing pointers is enough
+		if (entries[i].name == name || strcmp(entries[i].name, name) == 0)
+			return &entries[i];
+	}
+
+	if (nentries == MAX_ENTRIES)
+		log_printf_abort("too many different things to profile, max is %d", MAX_ENTRIES);
+	entries[nentries] = (struct ProfilerEntry){ .name = name, .istime = istime };
+	return &entries[nentries++];
+}
+
+static void add(const char *name, bool istime, uint64_t amount)
+{
+	SDL_AtomicLock(&lock);
+	struct ProfilerEntry *e = find_entry(name, istime);
+	e->ncalls++;
+	e->total += amount;
+	if (amount > e->max)
+		e->max = amount;
+	SDL_AtomicUnlock(&lock);
+}
+
+void profiler_stop(const char *name, uint64_t start)
+{
+	if (enabled)
+		add(name, true, SDL_GetPerformanceCounter() - start);
+}
+
+void profiler_count(const char *name, int amount)
+{
+	if (enabled)
+		add(name, false, (uint64_t)amount);
+}
+
+void profiler_dump(FILE *f)
+{
+	SDL_AtomicLock(&lock);
+	double ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+
+	fprintf(f, "%-40s %10s %12s %12s %12s\n", "", "calls", "total ms", "average ms", "max ms");
+	for (const struct ProfilerEntry *e = entries; e < &entries[nentries]; e++) {
+		if (e->istime)
+			fprintf(f, "%-40s %10llu %12.2f %12.4f %12.4f\n",
+				e->name, (unsigned long long)e->ncalls,
+				(double)e->total * ms,
+				(double)e->total * ms / (double)e->ncalls,
+				(double)e->max * ms);
+	}
+
+	fprintf(f, "\n%-40s %10s %12s %12s %12s\n", "", "calls", "total", "average", "max");
+	for (const struct ProfilerEntry *e = entries; e < &entries[nentries]; e++) {
+		if (!e->istime)
+			fprintf(f, "%-40s %10llu %12llu %12.2f %12llu\n",
+				e->name, (unsigned long long)e->ncalls,
+				(unsigned long long)e->total,
+				(double)e->total / (double)e->ncalls,
+				(unsigned long long)e->max);
+	}
+
+	SDL_AtomicUnlock(&lock);
+}
+
+void profiler_reset(void)
+{
+	SDL_AtomicLock(&lock);
+	nentries = 0;
+	SDL_AtomicUnlock(&lock);
+}
@@ -0,0 +1,31 @@
+/*
+Measuring where the time goes. The profiler is disabled by default, and then
+all these functions are very cheap. It's fine to use the profiler in many
+threads at the same time.
+
+	uint64_t start = profiler_start();
+	do_something();
+	profiler_stop("doing something", start);
+
+The names must be string literals, or otherwise live until the program exits.
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+void profiler_enable(bool enable);
+uint64_t profiler_start(void);
+void profiler_stop(const char *name, uint64_t start);
+
+// for things that aren't measured in time, e.g. how many times something happened
+void profiler_count(const char *name, int amount);
+
+// Prints a table of everything measured so far
+void profiler_dump(FILE *f);
+void profiler_reset(void);
+
+#endif   // PROFILER_H
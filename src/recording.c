@@ -0,0 +1,199 @@
+#include "recording.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <SDL2/SDL.h>
+#include "gamestate.h"
+#include "glob.h"
+#include "log.h"
+#include "map.h"
+#include "max.h"
+#include "misc.h"
+
+#define MAGIC "3DGREC"
+#define VERSION 5   // change this when old recordings would play differently
+
+// When creating a new recording, delete oldest recordings so that this many are left
+#define MAX_RECORDINGS 20
+
+enum Action { ACTION_RELEASE, ACTION_PRESS, ACTION_END };
+
+static void delete_old_recordings(void)
+{
+	glob_t gl;
+	if (glob("recordings/*.rec", 0, NULL, &gl) != 0)
+		return;
+
+	// file names are dates, so sorted alphabetically means sorted by age
+	for (size_t i = 0; i + MAX_RECORDINGS <= gl.gl_pathc; i++) {
+		log_printf("removing old recording \"%s\"", gl.gl_pathv[i]);
+		if (remove(gl.gl_pathv[i]) != 0)
+			log_printf("removing failed: %s", strerror(errno));
+	}
+	globfree(&gl);
+}
+
+FILE *recording_create(const struct GameState *gs, uint64_t seed)
+{
+	my_mkdir("recordings");
+	delete_old_recordings();
+
+	char path[100] = {0};
+	strftime(
+		path, sizeof(path)-1,
+		"recordings/%Y-%m-%d-%H%M%S.rec",
+		localtime((time_t[]){ time(NULL) })
+	);
+
+	// "b" to make sure that windows doesn't do anything to newline bytes
+	FILE *f = fopen(path, "wb");
+	if (!f) {
+		log_printf("opening \"%s\" failed, not recording the game: %s", path, strerror(errno));
+		return NULL;
+	}
+	log_printf("recording the game to \"%s\"", path);
+
+	fwrite(MAGIC, 1, strlen(MAGIC), f);
+	write_number(f, VERSION, 1);
+	write_number(f, seed, 8);
+	write_number(f, gs->huntingenemies, 1);
+	write_number(f, (uint64_t)gs->nplayers, 1);
+	write_string(f, gs->map->path);
+	for (int i = 0; i < gs->nplayers; i++) {
+		const struct EllipsoidPic *epic = gs->players[i].ellipsoid.epic;
+		write_string(f, epic ? epic->path : "");
+	}
+	fflush(f);
+	return f;
+}
+
+void recording_add_key(FILE *f, uint32_t frame, int scancode, bool down)
+{
+	if (!f)
+		return;
+	write_number(f, frame, 4);
+	write_number(f, (uint64_t)scancode, 2);
+	write_number(f, down ? ACTION_PRESS : ACTION_RELEASE, 1);
+
+	// if the game crashes, the recording is still useful
+	fflush(f);
+}
+
+void recording_finish(FILE *f, uint32_t nframes)
+{
+	if (!f)
+		return;
+	write_number(f, nframes, 4);
+	write_number(f, 0, 2);
+	write_number(f, ACTION_END, 1);
+	if (fclose(f) != 0)
+		log_printf("closing recording file failed: %s", strerror(errno));
+}
+
+static bool read_key(FILE *f, struct Recording *rec, bool *end)
+{
+	uint64_t frame, scancode, action;
+	if (!read_number(f, &frame, 4) || !read_number(f, &scancode, 2) || !read_number(f, &action, 1))
+		return false;
+
+	rec->nframes = (uint32_t)frame;
+	if (action == ACTION_END) {
+		*end = true;
+		return true;
+	}
+
+	rec->keys = realloc(rec->keys, sizeof(rec->keys[0]) * (rec->nkeys + 1));
+	if (!rec->keys)
+		log_printf_abort("not enough memory for %d recorded keys", rec->nkeys + 1);
+	rec->keys[rec->nkeys++] = (struct RecordedKey){
+		.frame = (uint32_t)frame,
+		.scancode = (int)scancode,
+		.down = (action == ACTION_PRESS),
+	};
+	return true;
+}
+
+struct Recording *recording_load(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		log_printf("opening \"%s\" failed: %s", path, strerror(errno));
+		return NULL;
+	}
+
+	struct Recording *rec = calloc(1, sizeof(*rec));
+	if (!rec)
+		log_printf_abort("not enough memory");
+
+	char magic[sizeof MAGIC] = {0};
+	uint64_t version;
+	if (fread(magic, 1, strlen(MAGIC), f) != strlen(MAGIC) || strcmp(magic, MAGIC) != 0
+			|| !read_number(f, &version, 1) || version != VERSION) {
+		log_printf("\"%s\" is not a recording file, or it's from a different version of the game", path);
+		goto error;
+	}
+
+	uint64_t hunting, nplayers;
+	if (!read_number(f, &rec->seed, 8)
+			|| !read_number(f, &hunting, 1)
+			|| !read_number(f, &nplayers, 1)
+			|| !read_string(f, rec->mappath, sizeof rec->mappath)) {
+		log_printf("\"%s\" is truncated", path);
+		goto error;
+	}
+	if (nplayers < 2 || nplayers > MAX_PLAYERS) {
+		log_printf("\"%s\" has %d players, should be between 2 and %d", path, (int)nplayers, MAX_PLAYERS);
+		goto error;
+	}
+	for (int i = 0; i < (int)nplayers; i++) {
+		if (!read_string(f, rec->plrpicpaths[i], sizeof rec->plrpicpaths[i])) {
+			log_printf("\"%s\" is truncated", path);
+			goto error;
+		}
+	}
+
+	rec->huntingenemies = (hunting != 0);
+	rec->nplayers = (int)nplayers;
+
+	bool end = false;
+	while (!end && read_key(f, rec, &end)) { }
+	if (!end)
+		log_printf("\"%s\" doesn't have the end marker, maybe the game crashed?", path);
+
+	fclose(f);
+	log_printf("loaded \"%s\": map \"%s\", %d keys, %u frames", path, rec->mappath, rec->nkeys, rec->nframes);
+	return rec;
+
+error:
+	fclose(f);
+	recording_free(rec);
+	return NULL;
+}
+
+void recording_free(struct Recording *rec)
+{
+	if (rec)
+		free(rec->keys);
+	free(rec);
+}
+
+const struct Map *recording_find_map(const struct Recording *rec, const struct Map *maps, int nmaps)
+{
+	for (int i = 0; i < nmaps; i++) {
+		if (strcmp(maps[i].path, rec->mappath) == 0)
+			return &maps[i];
+	}
+	return NULL;
+}
+
+void recording_apply_keys(const struct Recording *rec, struct GameState *gs, int *idx)
+{
+	while (*idx < rec->nkeys && rec->keys[*idx].frame <= gs->thisframe) {
+		gamestate_handle_key(gs, rec->keys[*idx].scancode, rec->keys[*idx].down);
+		++*idx;
+	}
+}
@@ -0,0 +1,69 @@
+/*
+Recordings contain everything needed for playing the exact same game again:
+the random seed, the map, the player pictures, and when each key was pressed or
+released. This way a laggy game reported by someone can be replayed and profiled.
+
+The files are small and binary. All numbers are little-endian.
+
+	"3DGREC" and a version byte
+	seed (8 bytes)
+	1 if enemies hunt players (see flowfield.h), 0 if they walk randomly (1 byte)
+	number of players (1 byte)
+	map path, then a picture path for each player (each: 2 byte length, then utf-8)
+	keys until the end (each: 4 byte frame, 2 byte scancode, 1 byte action)
+
+Action is 0 for release, 1 for press, and 2 for the end of the game. If the
+game crashes, the file doesn't end with the end marker, but it's still usable.
+*/
+
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "gamestate.h"
+#include "map.h"
+#include "max.h"
+
+struct RecordedKey {
+	uint32_t frame;   // value of gs->thisframe when key was pressed or released
+	int scancode;
+	bool down;
+};
+
+struct Recording {
+	uint64_t seed;
+	bool huntingenemies;
+	char mappath[1024];
+	int nplayers;
+	char plrpicpaths[MAX_PLAYERS][1024];   // empty strings for games without pictures
+
+	struct RecordedKey *keys;
+	int nkeys;
+	uint32_t nframes;   // length of the game, or frame of last key if end is missing
+};
+
+/*
+Creates a new file in the recordings directory, and deletes old recordings.
+Returns NULL if something goes wrong, and then the game is just not recorded.
+*/
+FILE *recording_create(const struct GameState *gs, uint64_t seed);
+void recording_add_key(FILE *f, uint32_t frame, int scancode, bool down);
+void recording_finish(FILE *f, uint32_t nframes);
+
+// Returns NULL and logs a message on error. Free the result with recording_free().
+struct Recording *recording_load(const char *path);
+void recording_free(struct Recording *rec);
+
+// Returns NULL if map is not found
+const struct Map *recording_find_map(const struct Recording *rec, const struct Map *maps, int nmaps);
+
+/*
+Presses and releases the keys of the current frame. Keep calling this before
+each gamestate_eachframe(). The index is for remembering the next key to use,
+set it to zero in the beginning of the game.
+*/
+void recording_apply_keys(const struct Recording *rec, struct GameState *gs, int *idx);
+
+#endif   // RECORDING_H
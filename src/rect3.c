@@ -196,24 +196,27 @@ void rect3_drawrow(const struct Rect3Cache *cache, int y, int xmin, int xmax)
 		int width = cache->rect->img->width;
 		int height = cache->rect->img->height;
 		const uint32_t *pxsrc = cache->rect->img->data;
-		int xdiff = xmax-xmin;
 
 		// Ugly code, but vectorization friendly. Measurable perf improvement.
+		for (int x = xmin; x < xmax; x += CAMERA_STRIP_WIDTH) {
+			int xdiff = min(xmax - x, CAMERA_STRIP_WIDTH);
+			uint32_t *dst = pxstart + (x - xmin);
 #define LOOP for (int i = 0; i < xdiff; i++)
-#define ARRAY(T, Name) T Name[CAMERA_SCREEN_WIDTH]; LOOP Name[i]
-		ARRAY(float, xzr) = camera_screenx_to_xzr(cache->cam, xmin+i);
-		ARRAY(float, detM) = xzr[i]*detM_xzrcoeff + detM_noxzr;
-		ARRAY(float, a) = (xzr[i]*detMa_xzrcoeff + detMa_noxzr)/detM[i];
-		ARRAY(float, b) = (xzr[i]*detMb_xzrcoeff + detMb_noxzr)/detM[i];
-		ARRAY(int, picx) = (int)(a[i]*width);
-		ARRAY(int, picy) = (int)(b[i]*height);
-		LOOP clamp(&picx[i], 0, width-1);
-		LOOP clamp(&picy[i], 0, height-1);
-		ARRAY(int, idx) = width*picy[i] + picx[i];
-		ARRAY(uint32_t, px) = pxsrc[idx[i]];
-		LOOP if (px[i] != ~(uint32_t)0) pxstart[i] = px[i];
+#define ARRAY(T, Name) T Name[CAMERA_STRIP_WIDTH]; LOOP Name[i]
+			ARRAY(float, xzr) = camera_screenx_to_xzr(cache->cam, x+i);
+			ARRAY(float, detM) = xzr[i]*detM_xzrcoeff + detM_noxzr;
+			ARRAY(float, a) = (xzr[i]*detMa_xzrcoeff + detMa_noxzr)/detM[i];
+			ARRAY(float, b) = (xzr[i]*detMb_xzrcoeff + detMb_noxzr)/detM[i];
+			ARRAY(int, picx) = (int)(a[i]*width);
+			ARRAY(int, picy) = (int)(b[i]*height);
+			LOOP clamp(&picx[i], 0, width-1);
+			LOOP clamp(&picy[i], 0, height-1);
+			ARRAY(int, idx) = width*picy[i] + picx[i];
+			ARRAY(uint32_t, px) = pxsrc[idx[i]];
+			LOOP if (px[i] != ~(uint32_t)0) dst[i] = px[i];
 #undef LOOP
 #undef ARRAY
+		}
 	} else {
 		// rgb_average seems to perform better when one argument is compile-time known
 		const SDL_PixelFormat *f = surf->format;
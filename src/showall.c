@@ -1,7 +1,10 @@
 #include "showall.h"
 #include <SDL2/SDL.h>
+#include <limits.h>
 #include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include "camera.h"
 #include "ellipsoid.h"
@@ -10,73 +13,404 @@
 #include "log.h"
 #include "max.h"
 #include "misc.h"
+#include "profiler.h"
 #include "rect3.h"
+#include "wallgrid.h"
 
 // fitting too much stuff into an integer
-typedef unsigned short ID;
+typedef uint32_t ID;
 #define ID_TYPE_ELLIPSOID 0
 #define ID_TYPE_RECT 1
 #define ID_TYPE(id) ((id) & 1)
 #define ID_INDEX(id) ((id) >> 1)
-#define ID_NEW(type, idx) ((type) | ((idx) << 1))
-
-// length of array indexed by id
-#define ARRAYLEN_INDEXED_BY_ID max( \
-	ID_NEW(ID_TYPE_ELLIPSOID, MAX_ELLIPSOIDS-1) + 1, \
-	ID_NEW(ID_TYPE_RECT, MAX_RECTS-1) + 1 \
-)
-
-// length of array containing ids
-#define ARRAYLEN_CONTAINING_ID (MAX_ELLIPSOIDS + MAX_RECTS)
+#define ID_NEW(type, idx) ((ID)(type) | ((ID)(idx) << 1))
+#define ID_NONE ((ID)-1)   // in idbuf, for pixels where nothing was drawn
 
 struct Info {
 	// dependencies must be displayed first, they go to behind the ellipsoid or rect
-	ID deps[ARRAYLEN_CONTAINING_ID];
+	ID *deps;
 	int ndeps;
+	int nremoved;  // dependencies removed to break cycles, they are in deps after the ndeps others
+	int depsalloced;
 
 	SDL_Rect bbox;	// bounding box
 	struct Rect3 sortrect;
 	bool sortingdone;  // for sorting infos to display them in correct order
+	int visidx;  // index into visible array, for sorting
+	unsigned visibleframe;  // value of frame in ShowingState when this was visible last time, 0 for never
+	bool wasvisible;  // visible on previous frame
+	bool changed;  // dependencies must be found again, because bbox or sortrect isn't same as on previous frame
+	uint32_t brightness;  // for rgb_scale(), less than 256 when near the far plane
 
 	struct Rect3Cache rcache;  // ID_TYPE_RECT only
+	const struct Ellipsoid *el;  // ID_TYPE_ELLIPSOID only, points into a span
+	int nstacked;  // ID_TYPE_ELLIPSOID only, how many ellipsoids from el onwards, more than 1 for stacks
+	int miplevel;  // ID_TYPE_ELLIPSOID only, not used for stacks
+	bool useimpostor;  // ID_TYPE_ELLIPSOID only
+	struct EllipsoidImpostor impostor;  // ID_TYPE_ELLIPSOID only, if useimpostor
 };
 
+/*
+There's no max number of objects. All arrays grow as needed, and they are kept
+for the next frame, so that they don't need to be allocated again.
+*/
 struct ShowingState {
 	const struct Camera *cam;
-	const struct Rect3 *rects;           // indexed by ID_INDEX(rect id)
-	const struct Ellipsoid *els;        // indexed by ID_INDEX(ellipsoid id)
-	struct Info infos[ARRAYLEN_INDEXED_BY_ID];
+	const struct ShowAllWorld *world;
+	const struct Rect3 *rects;           // indexed by ID_INDEX(rect id), same as world->rects
+	struct Info *infos;                  // indexed by id, zeroed when it grows
+	int infosalloced;
 
-	ID visible[ARRAYLEN_CONTAINING_ID];
+	// Arrays below that are indexed by visible index or contain ids have room for objalloced objects
+	int objalloced;
+	ID *visible;
 	int nvisible;
 
-	// Visible objects in the order in which they are drawn (closest to camera last)
-	ID objects_by_y[CAMERA_SCREEN_HEIGHT][ARRAYLEN_CONTAINING_ID];
-	int nobjects_by_y[CAMERA_SCREEN_HEIGHT];
+	/*
+	Things that are remembered between frames. When the camera doesn't move,
+	most objects have the same bbox and sortrect as on the previous frame, and
+	their dependencies don't need to be found again. The previous order of
+	drawing is used as a starting point, so that objects that can be drawn in
+	any order keep the same order from one frame to the next.
+	*/
+	unsigned frame;  // incremented on each call to show_all()
+	bool camchanged;  // everything must be figured out again
+	Vec3 prevcamlocation;
+	Mat3 prevcam2world;
+	ID *order;  // previous frame, closest to camera last
+	int norder;
+
+	// indexed like visible array, camera is on the positive side of each plane
+	struct Plane *planes;
+
+	// For functions below, indexed like visible array
+	int *changed, *ndepsleft, *queue, *revstart, *revfill;   // revstart has objalloced+1 elements
+	ID *sorted;
+	struct Interval *intervals;
+
+	// Reverse edges of dependencies, see create_showing_order_from_dependencies()
+	int *revedges;
+	int revedgesalloced;
+
+	/*
+	Visible objects on row y in the order in which they are drawn (closest to
+	camera last) are objects_by_y[rowstart[y]], ..., objects_by_y[rowstart[y+1] - 1].
+	*/
+	ID *objects_by_y;
+	int objects_by_y_alloced;
+	int *rowstart, *rowfill;  // room for rowsalloced elements, at least surface height + 1
+	int rowsalloced;
+	struct Interval *nonoverlap;
+	int nonoverlapalloced;
+
+	// Indexed like ellipsoid ids, room for elsalloced ellipsoids
+	int elsalloced;
+	bool *elvisible;  // for ellipsoid_visible_many(), indexed within a span
+	SDL_Rect *stackbboxes;  // bounding boxes of each ellipsoid in stacks, empty if not visible
+	int *stackxmin, *stackxmax;  // x ranges on the row being drawn, xmin > xmax if not on the row
+	int *stackmiplevels;  // each ellipsoid in a stack can be at a different distance from camera
+	uint32_t *stackbrightness;
+
+	bool *maybevisible;  // indexed by rect index
+	int maybevisiblealloced;
+
+	// See showall_enable_idbuffer(). Indexed by y*idbufw + x, object drawn last to each pixel.
+	bool wantids;
+	ID *idbuf;
+	int idbufw, idbufh, idbufalloced;
+
+	// For crosscheck_dependencies(), dependencies of each visible object, one after another
+	ID *saveddeps;
+	int saveddepsalloced;
+	ID *freshdeps;
+	int freshdepsalloced;
+	ID *savedremoved;  // pairs of (object, dependency removed from it to break a cycle)
+	int savedremovedalloced;
 };
 
-static void add_ellipsoid_if_visible(struct ShowingState *st, int idx)
+/*
+Things fade to black when they get near the far plane, so that they don't
+suddenly appear from nowhere. This is per object, not per pixel, because it's
+much cheaper and looks good enough. Behind a wall, things get darkened twice,
+but walls are transparent anyway.
+*/
+#define FADE_FRACTION 0.2f   // how much of the draw distance is used for fading
+
+static uint32_t get_brightness(const struct Camera *cam, Vec3 center)
 {
-	if (ellipsoid_is_visible(&st->els[idx], st->cam)) {
-		ID id = ID_NEW(ID_TYPE_ELLIPSOID, idx);
-		st->visible[st->nvisible++] = id;
-		st->infos[id].ndeps = 0;
-		st->infos[id].bbox = ellipsoid_bbox(&st->els[idx], st->cam);
-		st->infos[id].sortrect = ellipsoid_get_sort_rect(&st->els[idx], st->cam);
-		st->infos[id].sortingdone = false;
+	if (cam->drawdistance <= 0)
+		return 256;
+
+	float depth = -camera_point_world2cam(cam, center).z;
+	float b = (cam->drawdistance - depth) / (FADE_FRACTION * cam->drawdistance);
+	clamp_float(&b, 0, 1);
+	return (uint32_t)(256*b);
+}
+
+/*
+Everything in the world that doesn't depend on the camera. Nothing is copied,
+so rects and spans must not change until all cameras are done.
+*/
+struct ShowAllWorld {
+	const struct Rect3 *rects;
+	int nrects;
+	const struct WallGrid *grid;
+	const struct EllipsoidSpan *spans;
+	int nspans;
+	int nels;   // in all spans together
+
+	// Plane of each rect in world coordinates. Sort rects of ellipsoids turn towards the camera, so they aren't here.
+	struct Plane *rectplanes;
+	int rectplanesalloced;
+};
+
+struct ShowAllContext {
+	// contains everything that show_all() remembers between frames
+	struct ShowingState st;
+	struct ShowAllWorld world;   // used only in show_all()
+};
+
+// static so that arrays don't need to be allocated again
+static struct ShowAllContext tmpctx;
+
+bool showall_crosscheck = false;
+
+struct ShowAllWorld *showall_world_new(void)
+{
+	struct ShowAllWorld *world = calloc(1, sizeof(*world));
+	if (!world)
+		log_printf_abort("not enough memory for show_all() world");
+	return world;
+}
+
+void showall_world_free(struct ShowAllWorld *world)
+{
+	if (world)
+		free(world->rectplanes);
+	free(world);
+}
+
+static struct Plane get_plane_of_rect(const struct Rect3 *r)
+{
+	const Vec3 *corners = r->corners;
+	Vec3 n = vec3_cross(vec3_sub(corners[0], corners[1]), vec3_sub(corners[2], corners[1]));
+	return (struct Plane){ .normal = n, .constant = vec3_dot(n, corners[0]) };
+}
+
+void showall_world_update(
+	struct ShowAllWorld *world,
+	const struct Rect3 *rects, int nrects, const struct WallGrid *grid,
+	const struct EllipsoidSpan *spans, int nspans)
+{
+	world->rects = rects;
+	world->nrects = nrects;
+	world->grid = grid;
+	world->spans = spans;
+	world->nspans = nspans;
+
+	world->nels = 0;
+	for (int i = 0; i < nspans; i++)
+		world->nels += spans[i].nels;
+
+	world->rectplanes = grow_array(world->rectplanes, &world->rectplanesalloced, nrects, sizeof(world->rectplanes[0]));
+	for (int i = 0; i < nrects; i++)
+		world->rectplanes[i] = get_plane_of_rect(&rects[i]);
+}
+
+struct ShowAllContext *showall_context_new(void)
+{
+	// calloc because a zeroed ShowingState is empty
+	struct ShowAllContext *ctx = calloc(1, sizeof(*ctx));
+	if (!ctx)
+		log_printf_abort("not enough memory for show_all() context");
+	return ctx;
+}
+
+void showall_context_free(struct ShowAllContext *ctx)
+{
+	if (!ctx)
+		return;
+
+	struct ShowingState *st = &ctx->st;
+	for (int i = 0; i < st->infosalloced; i++)
+		free(st->infos[i].deps);
+	free(st->infos);
+	free(ctx->world.rectplanes);
+
+	void *arrays[] = {
+		st->visible, st->order, st->planes,
+		st->changed, st->ndepsleft, st->queue, st->revstart, st->revfill, st->sorted, st->intervals,
+		st->revedges, st->objects_by_y, st->rowstart, st->rowfill, st->nonoverlap,
+		st->elvisible, st->stackbboxes, st->stackxmin, st->stackxmax, st->stackmiplevels, st->stackbrightness,
+		st->maybevisible, st->idbuf, st->saveddeps, st->freshdeps, st->savedremoved,
+	};
+	for (int i = 0; i < sizeof(arrays)/sizeof(arrays[0]); i++)
+		free(arrays[i]);
+	free(ctx);
+}
+
+static void *resize_array(void *arr, int n, size_t elemsize)
+{
+	void *res = realloc(arr, (size_t)n * elemsize);
+	if (!res)
+		log_printf_abort("not enough memory for show_all(), %d elements of size %d", n, (int)elemsize);
+	return res;
+}
+
+#define RESIZE(Arr, N) ((Arr) = resize_array((Arr), (N), sizeof((Arr)[0])))
+
+static void make_room(struct ShowingState *st, int nels, int nrects)
+{
+	int nids = max(ID_NEW(ID_TYPE_ELLIPSOID, nels), ID_NEW(ID_TYPE_RECT, nrects));
+	if (nids > st->infosalloced) {
+		int old = st->infosalloced;
+		st->infosalloced = max(nids, 2*old);
+		RESIZE(st->infos, st->infosalloced);
+		memset(&st->infos[old], 0, (st->infosalloced - old)*sizeof(st->infos[0]));
+	}
+
+	int nobjects = nels + nrects;
+	if (nobjects > st->objalloced) {
+		st->objalloced = max(nobjects, 2*st->objalloced);
+		int n = st->objalloced;
+		RESIZE(st->visible, n);
+		RESIZE(st->order, n);
+		RESIZE(st->planes, n);
+		RESIZE(st->changed, n);
+		RESIZE(st->ndepsleft, n);
+		RESIZE(st->queue, n);
+		RESIZE(st->revstart, n+1);
+		RESIZE(st->revfill, n);
+		RESIZE(st->sorted, n);
+		RESIZE(st->intervals, n);
+	}
+
+	if (nels > st->elsalloced) {
+		st->elsalloced = max(nels, 2*st->elsalloced);
+		int n = st->elsalloced;
+		RESIZE(st->elvisible, n);
+		RESIZE(st->stackbboxes, n);
+		RESIZE(st->stackxmin, n);
+		RESIZE(st->stackxmax, n);
+		RESIZE(st->stackmiplevels, n);
+		RESIZE(st->stackbrightness, n);
+	}
+
+	st->maybevisible = grow_array(st->maybevisible, &st->maybevisiblealloced, nrects, sizeof(st->maybevisible[0]));
+
+	// Surfaces of cameras don't change size, so no need to grow in bigger steps
+	int h = st->cam->surface->h;
+	if (h + 1 > st->rowsalloced) {
+		st->rowsalloced = h + 1;
+		RESIZE(st->rowstart, h + 1);
+		RESIZE(st->rowfill, h + 1);
 	}
 }
 
+#undef RESIZE
+
+static bool same_rect3(const struct Rect3 *a, const struct Rect3 *b)
+{
+	return memcmp(a->corners, b->corners, sizeof(a->corners)) == 0
+		&& a->img == b->img
+		&& a->highlight == b->highlight;
+}
+
+// Dependencies depend only on bbox and sortrect, in addition to camera
+static void set_bbox_and_sortrect(struct ShowingState *st, struct Info *info, SDL_Rect bbox, const struct Rect3 *sortrect)
+{
+	// frame is never 0 here, so visibleframe is 0 only for things that were never visible
+	info->wasvisible = (info->visibleframe != 0 && info->visibleframe == st->frame - 1);
+	info->changed = st->camchanged
+		|| !info->wasvisible
+		|| !SDL_RectEquals(&info->bbox, &bbox)
+		|| !same_rect3(&info->sortrect, sortrect);
+	info->visibleframe = st->frame;
+	info->bbox = bbox;
+	info->sortrect = *sortrect;
+}
+
+static struct Info *add_ellipsoid_info(struct ShowingState *st, ID id, const struct Ellipsoid *el)
+{
+	st->visible[st->nvisible++] = id;
+	struct Info *info = &st->infos[id];
+	info->sortingdone = false;
+	info->brightness = get_brightness(st->cam, el->center);
+	info->el = el;
+	info->nstacked = 1;
+	return info;
+}
+
+// firstidx is a running number over all spans
+static void add_visible_ellipsoids(struct ShowingState *st, const struct EllipsoidSpan *span, int firstidx)
+{
+	bool *visible = st->elvisible;
+	ellipsoid_visible_many(span->els, span->nels, st->cam, visible);
+
+	for (int i = 0; i < span->nels; i++) {
+		if (!visible[i])
+			continue;
+
+		const struct Ellipsoid *el = &span->els[i];
+		struct Info *info = add_ellipsoid_info(st, ID_NEW(ID_TYPE_ELLIPSOID, firstidx + i), el);
+		struct Rect3 sortrect = ellipsoid_get_sort_rect(el, st->cam);
+		SDL_Rect unclipped = ellipsoid_bbox_unclipped(el, st->cam);
+		set_bbox_and_sortrect(st, info, ellipsoid_clip_bbox(el, st->cam, unclipped), &sortrect);
+		info->useimpostor = ellipsoid_get_impostor(el, st->cam, unclipped, &info->impostor);
+		if (!info->useimpostor)
+			info->miplevel = ellipsoid_choose_miplevel(unclipped, st->cam->lodbias);
+	}
+}
+
+// The whole stack gets the id of the bottom ellipsoid
+static void add_visible_stack(struct ShowingState *st, const struct EllipsoidSpan *span, int firstidx)
+{
+	bool *visible = st->elvisible;
+	ellipsoid_visible_many(span->els, span->nels, st->cam, visible);
+
+	int xmin = INT_MAX, ymin = INT_MAX, xmax = INT_MIN, ymax = INT_MIN;
+	for (int i = 0; i < span->nels; i++) {
+		SDL_Rect *bbox = &st->stackbboxes[firstidx + i];
+		if (!visible[i]) {
+			*bbox = (SDL_Rect){0};
+			continue;
+		}
+		SDL_Rect unclipped = ellipsoid_bbox_unclipped(&span->els[i], st->cam);
+		*bbox = ellipsoid_clip_bbox(&span->els[i], st->cam, unclipped);
+		st->stackmiplevels[firstidx + i] = ellipsoid_choose_miplevel(unclipped, st->cam->lodbias);
+		st->stackbrightness[firstidx + i] = get_brightness(st->cam, span->els[i].center);
+		xmin = min(xmin, bbox->x);
+		ymin = min(ymin, bbox->y);
+		xmax = max(xmax, bbox->x + bbox->w);
+		ymax = max(ymax, bbox->y + bbox->h);
+	}
+	if (xmin == INT_MAX)
+		return;   // nothing visible
+
+	const struct Ellipsoid *bottom = &span->els[0];
+	const struct Ellipsoid *top = &span->els[span->nels - 1];
+	struct Info *info = add_ellipsoid_info(st, ID_NEW(ID_TYPE_ELLIPSOID, firstidx), bottom);
+	info->nstacked = span->nels;
+	info->useimpostor = false;
+
+	// Bottom corners of bottom ellipsoid, top corners of top ellipsoid
+	struct Rect3 toprect = ellipsoid_get_sort_rect(top, st->cam);
+	struct Rect3 sortrect = ellipsoid_get_sort_rect(bottom, st->cam);
+	sortrect.corners[0] = toprect.corners[0];
+	sortrect.corners[1] = toprect.corners[1];
+	set_bbox_and_sortrect(st, info, (SDL_Rect){ xmin, ymin, xmax-xmin, ymax-ymin }, &sortrect);
+}
+
 static void add_rect_if_visible(struct ShowingState *st, int idx)
 {
 	struct Rect3Cache rcache;
 	if (rect3_visible_fillcache(&st->rects[idx], st->cam, &rcache)) {
 		ID id = ID_NEW(ID_TYPE_RECT, idx);
 		st->visible[st->nvisible++] = id;
-		st->infos[id].ndeps = 0;
-		st->infos[id].bbox = rcache.bbox;
-		st->infos[id].sortrect = st->rects[idx];
+		set_bbox_and_sortrect(st, &st->infos[id], rcache.bbox, &st->rects[idx]);
 		st->infos[id].sortingdone = false;
+		st->infos[id].brightness = get_brightness(st->cam,
+			vec3_mul_float(vec3_add(st->rects[idx].corners[0], st->rects[idx].corners[2]), 0.5f));
 		st->infos[id].rcache = rcache;
 	}
 }
@@ -84,11 +418,14 @@ static void add_rect_if_visible(struct ShowingState *st, int idx)
 // Debugging hint: rect3_drawborder
 static void add_dependency(struct ShowingState *st, ID before, ID after)
 {
-	for (int i = 0; i < st->infos[after].ndeps; i++) {
-		if (st->infos[after].deps[i] == before)
+	struct Info *info = &st->infos[after];
+	for (int i = 0; i < info->ndeps; i++) {
+		if (info->deps[i] == before)
 			return;
 	}
-	st->infos[after].deps[st->infos[after].ndeps++] = before;
+	SDL_assert(info->nremoved == 0);
+	info->deps = grow_array(info->deps, &info->depsalloced, info->ndeps + 1, sizeof(info->deps[0]));
+	info->deps[info->ndeps++] = before;
 }
 
 // Return value: +-1 = all points on pos/neg side, 0 = points on different sides or all almost on plane
@@ -112,210 +449,592 @@ static int side_of_all_four_points(const struct Plane *pl, const Vec3 *points)
 	return res;
 }
 
-static void setup_dependencies(struct ShowingState *st)
+// i and k are indexes into visible array
+static void add_dependencies_of_pair(struct ShowingState *st, int i, int k)
 {
-	static struct Plane planes[sizeof st->visible / sizeof st->visible[0]];  // in camera coordinates
-	static Vec3 camcorners[sizeof st->visible / sizeof st->visible[0]][4];  // in camera coordinates
+	const struct Info *iinfo = &st->infos[st->visible[i]];
+	const struct Info *kinfo = &st->infos[st->visible[k]];
+
+	// Do not add dependencies between two walls
+	if (ID_TYPE(st->visible[i]) == ID_TYPE_RECT
+		&& ID_TYPE(st->visible[k]) == ID_TYPE_RECT
+		&& iinfo->rcache.rect->img == NULL
+		&& kinfo->rcache.rect->img == NULL
+		&& iinfo->rcache.rect->highlight == kinfo->rcache.rect->highlight)
+	{
+		return;
+	}
+
+	int xstart = max(iinfo->bbox.x, kinfo->bbox.x);
+	int xend = min(iinfo->bbox.x + iinfo->bbox.w, kinfo->bbox.x + kinfo->bbox.w);
+	if (xstart > xend)
+		return;
+
+	int ystart = max(iinfo->bbox.y, kinfo->bbox.y);
+	int yend = min(iinfo->bbox.y + iinfo->bbox.h, kinfo->bbox.y + kinfo->bbox.h);
+	if (ystart > yend)
+		return;
 
+	int s1 = side_of_all_four_points(&st->planes[i], kinfo->sortrect.corners);
+	int s2 = side_of_all_four_points(&st->planes[k], iinfo->sortrect.corners);
+	if (s1 == s2 && s1 != 0) {
+		/*
+		Both walls think they are on same/different side of the other wall as camera.
+		Example of when this happens:
+
+			 /  \
+			/    \
+
+			 cam
+
+		Avoid dependency cycle, order doesn't seem to matter.
+		*/
+		return;
+	}
+
+	if (s1 == -1 || s2 == 1)
+		add_dependency(st, st->visible[k], st->visible[i]);
+	if (s1 == 1 || s2 == -1)
+		add_dependency(st, st->visible[i], st->visible[k]);
+}
+
+static void setup_dependencies(struct ShowingState *st)
+{
+	// Everything is in world coordinates, so rect planes come from the world as is
 	for (int i = 0; i < st->nvisible; i++) {
-		const Vec3 *corners = st->infos[st->visible[i]].sortrect.corners;
-		Vec3 n = vec3_cross(vec3_sub(corners[0], corners[1]), vec3_sub(corners[2], corners[1]));
-		struct Plane pl = { .normal = n, .constant = vec3_dot(n, corners[0]) };
-		plane_move(&pl, vec3_mul_float(st->cam->location, -1));
-		plane_apply_mat3_INVERSE(&pl, st->cam->cam2world);
-
-		// Make sure that camera (0,0,0) is on the positive side of the plane
-		if (pl.constant < 0) {
+		ID id = st->visible[i];
+		struct Plane pl;
+		if (ID_TYPE(id) == ID_TYPE_RECT)
+			pl = st->world->rectplanes[ID_INDEX(id)];
+		else
+			pl = get_plane_of_rect(&st->infos[id].sortrect);
+
+		// Make sure that camera is on the positive side of the plane
+		if (pl.constant - vec3_dot(pl.normal, st->cam->location) < 0) {
 			pl.constant *= -1;
 			pl.normal.x *= -1;
 			pl.normal.y *= -1;
 			pl.normal.z *= -1;
 		}
-		planes[i] = pl;
-
-		for (int k=0; k<4; k++)
-			camcorners[i][k] = camera_point_world2cam(st->cam, corners[k]);
+		st->planes[i] = pl;
 	}
 
+	// Keep dependencies between objects that didn't change, including those removed to break cycles
+	int *changed = st->changed;   // indexes into visible array
+	int nchanged = 0;
 	for (int i = 0; i < st->nvisible; i++) {
-		const struct Info *iinfo = &st->infos[st->visible[i]];
-
-		for (int k = 0; k < i; k++) {
-			const struct Info *kinfo = &st->infos[st->visible[k]];
-
-			// Do not add dependencies between two walls
-			if (ID_TYPE(st->visible[i]) == ID_TYPE_RECT
-				&& ID_TYPE(st->visible[k]) == ID_TYPE_RECT
-				&& iinfo->rcache.rect->img == NULL
-				&& kinfo->rcache.rect->img == NULL
-				&& iinfo->rcache.rect->highlight == kinfo->rcache.rect->highlight)
-			{
-				continue;
+		struct Info *info = &st->infos[st->visible[i]];
+		if (info->changed) {
+			info->ndeps = 0;
+			changed[nchanged++] = i;
+		} else {
+			int n = 0;
+			for (int k = 0; k < info->ndeps + info->nremoved; k++) {
+				const struct Info *dep = &st->infos[info->deps[k]];
+				if (dep->visibleframe == st->frame && !dep->changed)
+					info->deps[n++] = info->deps[k];
 			}
+			info->ndeps = n;
+		}
+		info->nremoved = 0;
+	}
 
-			int xstart = max(iinfo->bbox.x, kinfo->bbox.x);
-			int xend = min(iinfo->bbox.x + iinfo->bbox.w, kinfo->bbox.x + kinfo->bbox.w);
-			if (xstart > xend)
-				continue;
+	// Each pair that has a changed object is checked once
+	for (int c = 0; c < nchanged; c++) {
+		int i = changed[c];
+		for (int k = 0; k < st->nvisible; k++) {
+			if (k != i && (k < i || !st->infos[st->visible[k]].changed))
+				add_dependencies_of_pair(st, i, k);
+		}
+	}
+}
 
-			int ystart = max(iinfo->bbox.y, kinfo->bbox.y);
-			int yend = min(iinfo->bbox.y + iinfo->bbox.h, kinfo->bbox.y + kinfo->bbox.h);
-			if (ystart > yend)
-				continue;
+static int compare_ids(const void *a, const void *b)
+{
+	ID x = *(const ID *)a, y = *(const ID *)b;
+	return (x > y) - (x < y);
+}
 
-			int s1 = side_of_all_four_points(&planes[i], camcorners[k]);
-			int s2 = side_of_all_four_points(&planes[k], camcorners[i]);
-			if (s1 == s2 && s1 != 0) {
-				/*
-				Both walls think they are on same/different side of the other wall as camera.
-				Example of when this happens:
+// Objects that were visible on previous frame go first, in the order they were drawn
+static void sort_visible_like_previous_frame(struct ShowingState *st)
+{
+	ID *sorted = st->sorted;
+	int n = 0;
 
-					 /  \
-					/    \
+	for (int i = 0; i < st->norder; i++) {
+		if (st->infos[st->order[i]].visibleframe == st->frame)
+			sorted[n++] = st->order[i];
+	}
+	for (int i = 0; i < st->nvisible; i++) {
+		if (!st->infos[st->visible[i]].wasvisible)
+			sorted[n++] = st->visible[i];
+	}
 
-					 cam
+	SDL_assert(n == st->nvisible);
+	memcpy(st->visible, sorted, n*sizeof(sorted[0]));
+}
 
-				Avoid dependency cycle, order doesn't seem to matter.
-				*/
-				continue;
-			}
+// Uses the order of drawing, so that objects of each row are in that order too
+static void find_objects_by_y(struct ShowingState *st)
+{
+	int h = st->cam->surface->h;
+	memset(st->rowstart, 0, (h+1)*sizeof(st->rowstart[0]));
+	for (int i = 0; i < st->norder; i++) {
+		SDL_Rect bbox = st->infos[st->order[i]].bbox;
+		SDL_assert(0 <= bbox.y && bbox.y+bbox.h <= h);
+		for (int y = bbox.y; y < bbox.y+bbox.h; y++)
+			st->rowstart[y+1]++;
+	}
+	for (int y = 0; y < h; y++)
+		st->rowstart[y+1] += st->rowstart[y];
 
-			if (s1 == -1 || s2 == 1)
-				add_dependency(st, st->visible[k], st->visible[i]);
-			if (s1 == 1 || s2 == -1)
-				add_dependency(st, st->visible[i], st->visible[k]);
-		}
+	st->objects_by_y = grow_array(st->objects_by_y, &st->objects_by_y_alloced, st->rowstart[h], sizeof(st->objects_by_y[0]));
+	memcpy(st->rowfill, st->rowstart, h*sizeof(st->rowstart[0]));
+	for (int i = 0; i < st->norder; i++) {
+		SDL_Rect bbox = st->infos[st->order[i]].bbox;
+		for (int y = bbox.y; y < bbox.y+bbox.h; y++)
+			st->objects_by_y[st->rowfill[y]++] = st->order[i];
 	}
 }
 
-// Called for each visible object, in the order of drawing
-static void add_id_to_drawing_order(struct ShowingState *st, ID id)
+static ID next_dependency_not_drawn(const struct ShowingState *st, ID id)
 {
-	SDL_Rect bbox = st->infos[id].bbox;
-	SDL_assert(0 <= bbox.y && bbox.y+bbox.h <= st->cam->surface->h);
-	for (int y = bbox.y; y < bbox.y+bbox.h; y++)
-		st->objects_by_y[y][st->nobjects_by_y[y]++] = id;
+	const struct Info *info = &st->infos[id];
+	for (int i = 0; i < info->ndeps; i++) {
+		if (!st->infos[info->deps[i]].sortingdone)
+			return info->deps[i];
+	}
+	SDL_assert(0);
+	return id;
 }
 
-static void break_dependency_cycle(struct ShowingState *st, ID start)
+/*
+Called when no object is ready to be drawn, because there is a dependency cycle.
+Removes one dependency of the cycle and returns the object that lost it. Objects
+already drawn are ignored, and start must not be drawn yet.
+*/
+static ID break_dependency_cycle(struct ShowingState *st, ID start, ID *removeddep)
 {
 	/*
-	Consider the sequence (x_n), where x_1 = start and x_(n+1) = st->infos[x_n].deps[0].
-	If all elements have some dependencies, this is an infinite sequence of finitely many
-	elements to choose from, so it will eventually cycle. To find a cycle, we compare x_n
-	and x_(2n) until they match.
+	Consider the sequence (x_n), where x_1 = start and x_(n+1) = next(x_n) is
+	the first dependency of x_n that isn't drawn yet. All objects not drawn yet
+	have such a dependency, or they would be ready to draw. So this is an
+	infinite sequence of finitely many elements to choose from, and it will
+	eventually cycle. To find a cycle, we compare x_n and x_(2n) until they match.
 	*/
-#define next(x) st->infos[x].deps[0]
 	ID x = start;
-	ID y = next(start);
+	ID y = next_dependency_not_drawn(st, start);
 	while (x != y) {
-		x = next(x);
-		y = next(next(y));
+		x = next_dependency_not_drawn(st, x);
+		y = next_dependency_not_drawn(st, next_dependency_not_drawn(st, y));
 	}
-#undef next
 
-	st->infos[x].deps[0] = st->infos[x].deps[--st->infos[x].ndeps];
+	// Move the removed dependency to the end, so that it can be used on the next frame
+	struct Info *info = &st->infos[x];
+	for (int i = 0; i < info->ndeps; i++) {
+		if (!st->infos[info->deps[i]].sortingdone) {
+			*removeddep = info->deps[i];
+			info->ndeps--;
+			info->nremoved++;
+			info->deps[i] = info->deps[info->ndeps];
+			info->deps[info->ndeps] = *removeddep;
+			return x;
+		}
+	}
+	SDL_assert(0);
+	return x;
 }
 
+/*
+Kahn's algorithm: each object counts how many of its dependencies haven't been
+drawn yet. When an object is drawn, the objects that depend on it are found
+with reverse edges, and their counts go down. Objects whose count reaches 0 go
+to a queue of objects that are ready to be drawn.
+*/
 static void create_showing_order_from_dependencies(struct ShowingState *st)
 {
-	static ID todo[ARRAYLEN_CONTAINING_ID];
-	int ntodo = st->nvisible;
-	memcpy(todo, st->visible, ntodo*sizeof(todo[0]));
-
-	// Standard topological sort algorithm. I learned it from Python's toposort module
-	while (ntodo > 0) {
-		bool stuck = true;
-		for (int i = ntodo-1; i >= 0; i--) {
-			if (st->infos[todo[i]].ndeps == 0) {
-				add_id_to_drawing_order(st, todo[i]);
-				st->infos[todo[i]].sortingdone = true;
-				todo[i] = todo[--ntodo];
-				stuck = false;
+	int n = st->nvisible;
+	int *ndepsleft = st->ndepsleft;   // indexed by visible index
+	int *queue = st->queue;
+	int queuestart = 0, queueend = 0;
+
+	/*
+	Reverse edges: objects that depend on st->visible[i] are
+	revedges[revstart[i]], ..., revedges[revstart[i+1] - 1], as visible indexes.
+	Removed edges are set to -1.
+	*/
+	int *revstart = st->revstart;
+	int *revfill = st->revfill;
+
+	for (int i = 0; i < n; i++)
+		st->infos[st->visible[i]].visidx = i;
+
+	memset(revstart, 0, (n+1)*sizeof(revstart[0]));
+	for (int i = 0; i < n; i++) {
+		const struct Info *info = &st->infos[st->visible[i]];
+		for (int k = 0; k < info->ndeps; k++)
+			revstart[st->infos[info->deps[k]].visidx + 1]++;
+	}
+	for (int i = 0; i < n; i++)
+		revstart[i+1] += revstart[i];
+
+	st->revedges = grow_array(st->revedges, &st->revedgesalloced, revstart[n], sizeof(st->revedges[0]));
+	int *revedges = st->revedges;
+
+	memcpy(revfill, revstart, n*sizeof(revstart[0]));
+	for (int i = 0; i < n; i++) {
+		const struct Info *info = &st->infos[st->visible[i]];
+		for (int k = 0; k < info->ndeps; k++)
+			revedges[revfill[st->infos[info->deps[k]].visidx]++] = i;
+		ndepsleft[i] = info->ndeps;
+		if (info->ndeps == 0)
+			queue[queueend++] = i;
+	}
+
+	int ncycles = 0;
+	for (int ndrawn = 0; ndrawn < n; ndrawn++) {
+		while (queuestart == queueend) {
+			// Rare, so it doesn't matter that finding an object not drawn yet is slow
+			int start = 0;
+			while (st->infos[st->visible[start]].sortingdone)
+				start++;
+
+			ID removeddep;
+			ID id = break_dependency_cycle(st, st->visible[start], &removeddep);
+			ncycles++;
+
+			int before = st->infos[removeddep].visidx;
+			int after = st->infos[id].visidx;
+			for (int e = revstart[before]; e < revstart[before+1]; e++) {
+				if (revedges[e] == after) {
+					revedges[e] = -1;
+					break;
+				}
 			}
+			if (--ndepsleft[after] == 0)
+				queue[queueend++] = after;
 		}
-		if (stuck) {
-			log_printf("dependency cycle detected");
-			break_dependency_cycle(st, todo[0]);
-			continue;
+
+		int i = queue[queuestart++];
+		st->infos[st->visible[i]].sortingdone = true;
+		st->order[ndrawn] = st->visible[i];
+
+		for (int e = revstart[i]; e < revstart[i+1]; e++) {
+			int k = revedges[e];
+			if (k != -1 && --ndepsleft[k] == 0)
+				queue[queueend++] = k;
+		}
+	}
+
+	st->norder = n;
+	if (ncycles > 0)
+		profiler_count("dependency cycles", ncycles);
+}
+
+/*
+Finds all dependencies again without using anything remembered from previous
+frames, and aborts if they aren't the same as what setup_dependencies() found,
+or if the order of drawing doesn't respect them. Call this after
+create_showing_order_from_dependencies(). Dependencies removed to break cycles
+are the only ones that can be drawn in the wrong order.
+*/
+static void crosscheck_dependencies(struct ShowingState *st)
+{
+	// Where each object is in the order of drawing, indexed like visible array
+	int *pos = st->ndepsleft;
+	for (int i = 0; i < st->norder; i++)
+		pos[st->infos[st->order[i]].visidx] = i;
+
+	int total = 0, nremoved = 0;
+	for (int i = 0; i < st->nvisible; i++) {
+		total += st->infos[st->visible[i]].ndeps + st->infos[st->visible[i]].nremoved;
+		nremoved += st->infos[st->visible[i]].nremoved;
+	}
+	st->saveddeps = grow_array(st->saveddeps, &st->saveddepsalloced, total, sizeof(st->saveddeps[0]));
+	st->savedremoved = grow_array(st->savedremoved, &st->savedremovedalloced, 2*nremoved, sizeof(st->savedremoved[0]));
+	ID *saved = st->saveddeps;
+
+	ID *ptr = saved;
+	ID *rptr = st->savedremoved;
+	for (int i = 0; i < st->nvisible; i++) {
+		const struct Info *info = &st->infos[st->visible[i]];
+		int n = info->ndeps + info->nremoved;
+		for (int k = info->ndeps; k < n; k++) {
+			*rptr++ = st->visible[i];
+			*rptr++ = info->deps[k];
+		}
+		memcpy(ptr, info->deps, n*sizeof(ptr[0]));
+		qsort(ptr, n, sizeof(ptr[0]), compare_ids);
+		ptr += n;
+	}
+
+	for (int i = 0; i < st->nvisible; i++)
+		st->infos[st->visible[i]].changed = true;
+	setup_dependencies(st);
+
+	ptr = saved;
+	for (int i = 0; i < st->nvisible; i++) {
+		const struct Info *info = &st->infos[st->visible[i]];
+		st->freshdeps = grow_array(st->freshdeps, &st->freshdepsalloced, info->ndeps, sizeof(st->freshdeps[0]));
+		ID *fresh = st->freshdeps;
+		memcpy(fresh, info->deps, info->ndeps*sizeof(fresh[0]));
+		qsort(fresh, info->ndeps, sizeof(fresh[0]), compare_ids);
+		if (ptr + info->ndeps > saved + total || memcmp(ptr, fresh, info->ndeps*sizeof(fresh[0])) != 0) {
+			log_printf_abort(
+				"frame %u: remembered dependencies of object %d differ from dependencies computed from scratch",
+				st->frame, (int)st->visible[i]);
 		}
-		for (int i = 0; i < ntodo; i++) {
-			struct Info *info = &st->infos[todo[i]];
-			for (int k = info->ndeps-1; k >= 0; k--) {
-				if (st->infos[info->deps[k]].sortingdone)
-					info->deps[k] = info->deps[--info->ndeps];
+		ptr += info->ndeps;
+	}
+	if (ptr != saved + total)
+		log_printf_abort("frame %u: remembered dependencies differ from dependencies computed from scratch", st->frame);
+
+	for (int i = 0; i < st->nvisible; i++) {
+		const struct Info *info = &st->infos[st->visible[i]];
+		for (int k = 0; k < info->ndeps; k++) {
+			ID dep = info->deps[k];
+			if (pos[st->infos[dep].visidx] < pos[i])
+				continue;
+
+			bool removed = false;
+			for (int r = 0; r < nremoved; r++) {
+				if (st->savedremoved[2*r] == st->visible[i] && st->savedremoved[2*r + 1] == dep)
+					removed = true;
+			}
+			if (!removed) {
+				log_printf_abort(
+					"frame %u: object %d is drawn before object %d, but it must be drawn after it",
+					st->frame, (int)st->visible[i], (int)dep);
 			}
 		}
 	}
 }
 
+// Union of x ranges of all ellipsoids of the stack on row y, also saves the ranges for drawing
+static bool stack_xminmax(struct ShowingState *st, ID id, int y, int *xmin, int *xmax)
+{
+	const struct Info *info = &st->infos[id];
+	bool found = false;
+
+	for (int i = 0; i < info->nstacked; i++) {
+		int idx = ID_INDEX(id) + i;
+		const SDL_Rect *bbox = &st->stackbboxes[idx];
+		int *a = &st->stackxmin[idx];
+		int *b = &st->stackxmax[idx];
+		if (y < bbox->y || y >= bbox->y + bbox->h || !ellipsoid_xminmax(&info->el[i], st->cam, y, a, b)) {
+			*a = 1;
+			*b = 0;
+			continue;
+		}
+		*xmin = found ? min(*xmin, *a) : *a;
+		*xmax = found ? max(*xmax, *b) : *b;
+		found = true;
+	}
+	return found;
+}
+
 static bool get_xminmax(struct ShowingState *st, ID id, int y, int *xmin, int *xmax)
 {
 	switch(ID_TYPE(id)) {
-		case ID_TYPE_ELLIPSOID: return ellipsoid_xminmax(&st->els[ID_INDEX(id)], st->cam, y, xmin, xmax);
+		case ID_TYPE_ELLIPSOID:
+			if (st->infos[id].nstacked > 1)
+				return stack_xminmax(st, id, y, xmin, xmax);
+			return ellipsoid_xminmax(st->infos[id].el, st->cam, y, xmin, xmax);
 		case ID_TYPE_RECT: return rect3_xminmax(&st->infos[id].rcache, y, xmin, xmax);
 	}
 	return false;  // compiler = happy
 }
 
+static void darken_row(const struct Camera *cam, int y, int xmin, int xmax, uint32_t brightness)
+{
+	if (brightness < 256) {
+		SDL_Surface *surf = cam->surface;
+		uint32_t *px = (uint32_t *)surf->pixels + y*(surf->pitch/(int)sizeof(uint32_t));
+		for (int x = xmin; x < xmax; x++)
+			px[x] = rgb_scale(px[x], brightness);
+	}
+}
+
+// elidx is the index of el counting through all spans
+static void draw_stacked_ellipsoid_row(
+	const struct ShowingState *st, const struct Ellipsoid *el, int elidx, int y, int xmin, int xmax)
+{
+	ellipsoid_drawrow(el, st->cam, st->stackmiplevels[elidx], y, xmin, xmax);
+	darken_row(st->cam, y, xmin, xmax, st->stackbrightness[elidx]);
+}
+
+/*
+Upper ellipsoids go on top of lower ones. Drawing from top to bottom and
+skipping pixels that are already drawn avoids drawing the same pixel many
+times. The ellipsoids overlap, so the drawn pixels are always one range.
+
+Each ellipsoid gets its own mip level and brightness, so a stack looks the
+same as its ellipsoids drawn one by one.
+*/
+static void draw_stack_row(const struct ShowingState *st, ID id, int y, int xmin, int xmax)
+{
+	const struct Info *info = &st->infos[id];
+	int drawnstart = 0, drawnend = 0;
+
+	for (int i = info->nstacked - 1; i >= 0; i--) {
+		// stack_xminmax() was called for this row before drawing
+		int idx = ID_INDEX(id) + i;
+		int a = max(st->stackxmin[idx], xmin);
+		int b = min(st->stackxmax[idx], xmax);
+		if (a >= b)
+			continue;
+
+		if (drawnstart == drawnend) {
+			draw_stacked_ellipsoid_row(st, &info->el[i], idx, y, a, b);
+			drawnstart = a;
+			drawnend = b;
+		} else {
+			if (a < drawnstart)
+				draw_stacked_ellipsoid_row(st, &info->el[i], idx, y, a, drawnstart);
+			if (b > drawnend)
+				draw_stacked_ellipsoid_row(st, &info->el[i], idx, y, drawnend, b);
+			drawnstart = min(drawnstart, a);
+			drawnend = max(drawnend, b);
+		}
+	}
+}
+
 static void draw_row(const struct ShowingState *st, int y, ID id, int xmin, int xmax)
 {
 	switch(ID_TYPE(id)) {
 	case ID_TYPE_ELLIPSOID:
-		ellipsoid_drawrow(&st->els[ID_INDEX(id)], st->cam, y, xmin, xmax);
+		if (st->infos[id].nstacked > 1) {
+			draw_stack_row(st, id, y, xmin, xmax);
+			return;   // darkens each ellipsoid separately
+		}
+		if (st->infos[id].useimpostor)
+			ellipsoid_drawrow_impostor(&st->infos[id].impostor, st->cam, y, xmin, xmax);
+		else
+			ellipsoid_drawrow(st->infos[id].el, st->cam, st->infos[id].miplevel, y, xmin, xmax);
 		break;
 	case ID_TYPE_RECT:
 		rect3_drawrow(&st->infos[id].rcache, y, xmin, xmax);
 		break;
 	}
+	darken_row(st->cam, y, xmin, xmax, st->infos[id].brightness);
 }
 
-void show_all(
-	const struct Rect3 *rects, int nrects,
-	const struct Ellipsoid *els, int nels,
-	const struct Camera *cam)
+void showall_draw(struct ShowAllContext *ctx, const struct ShowAllWorld *world, const struct Camera *cam)
 {
-	SDL_assert(nrects <= MAX_RECTS);
-	SDL_assert(nels <= MAX_ELLIPSOIDS);
+	bool remember = (ctx != NULL);
+	if (!ctx)
+		ctx = &tmpctx;
 
-	// static to keep stack usage down
-	static struct ShowingState st;
-	st.cam = cam;
-	st.rects = rects;
-	st.els = els;
-	st.nvisible = 0;
-	memset(st.nobjects_by_y, 0, sizeof st.nobjects_by_y);
+	struct ShowingState *st = &ctx->st;
+	st->cam = cam;
+	st->world = world;
+	st->rects = world->rects;
+	st->nvisible = 0;
+	make_room(st, world->nels, world->nrects);
 
-	for (int i = 0; i < nels; i++)
-		add_ellipsoid_if_visible(&st, i);
-	for (int i = 0; i < nrects; i++)
-		add_rect_if_visible(&st, i);
+	// Dependencies depend on where the camera is, and bboxes depend on everything about the camera
+	st->frame++;
+	st->camchanged = !remember || st->frame == 1
+		|| memcmp(&st->prevcamlocation, &cam->location, sizeof(Vec3)) != 0
+		|| memcmp(&st->prevcam2world, &cam->cam2world, sizeof(Mat3)) != 0;
+	st->prevcamlocation = cam->location;
+	st->prevcam2world = cam->cam2world;
 
-	setup_dependencies(&st);
-	create_showing_order_from_dependencies(&st);
+	int elidx = 0;
+	for (const struct EllipsoidSpan *sp = world->spans; sp < &world->spans[world->nspans]; sp++) {
+		if (sp->stacked && sp->nels > 1)
+			add_visible_stack(st, sp, elidx);
+		else
+			add_visible_ellipsoids(st, sp, elidx);
+		elidx += sp->nels;
+	}
+	int ngrid = 0;
+	if (world->grid) {
+		SDL_assert(world->grid->nwalls <= world->nrects);
+		wallgrid_find_maybe_visible(world->grid, cam, st->maybevisible);
+		ngrid = world->grid->nwalls;
+	}
+	for (int i = 0; i < world->nrects; i++) {
+		if (i >= ngrid || st->maybevisible[i])
+			add_rect_if_visible(st, i);
+	}
+	if (remember)
+		sort_visible_like_previous_frame(st);
+	setup_dependencies(st);
+	create_showing_order_from_dependencies(st);
+	if (showall_crosscheck && remember)
+		crosscheck_dependencies(st);
+	find_objects_by_y(st);
+
+	if (st->wantids) {
+		st->idbufw = cam->surface->w;
+		st->idbufh = cam->surface->h;
+		st->idbuf = grow_array(st->idbuf, &st->idbufalloced, st->idbufw*st->idbufh, sizeof(st->idbuf[0]));
+		memset(st->idbuf, 0xff, st->idbufw*st->idbufh*sizeof(st->idbuf[0]));   // all ID_NONE
+	}
 
 	for (int y = 0; y < cam->surface->h; y++) {
-		static struct Interval intervals[ARRAYLEN_CONTAINING_ID];
+		struct Interval *intervals = st->intervals;
 		int nintervals = 0;
 
-		for (int i = 0; i < st.nobjects_by_y[y]; i++) {
-			ID id = st.objects_by_y[y][i];
+		for (int i = st->rowstart[y]; i < st->rowstart[y+1]; i++) {
+			ID id = st->objects_by_y[i];
 			int xmin, xmax;
-			if (get_xminmax(&st, id, y, &xmin, &xmax)) {
+			if (get_xminmax(st, id, y, &xmin, &xmax)) {
 				SDL_assert(xmin <= xmax);
 				intervals[nintervals++] = (struct Interval){
 					.start = xmin,
 					.end = xmax,
-					.id = id,
+					.id = (int)id,
 					.allowoverlap = (ID_TYPE(id) == ID_TYPE_RECT),
 				};
 			}
 		}
 
-		static struct Interval nonoverlap[INTERVAL_NON_OVERLAPPING_MAX(ARRAYLEN_CONTAINING_ID)];
-		int nnonoverlap = interval_non_overlapping(intervals, nintervals, nonoverlap);
+		int nnonoverlap = interval_non_overlapping(intervals, nintervals, &st->nonoverlap, &st->nonoverlapalloced);
+		for (int i = 0; i < nnonoverlap; i++) {
+			const struct Interval *in = &st->nonoverlap[i];
+			draw_row(st, y, (ID)in->id, in->start, in->end);
 
-		for (int i = 0; i < nnonoverlap; i++)
-			draw_row(&st, y, nonoverlap[i].id, nonoverlap[i].start, nonoverlap[i].end);
+			// Walls can overlap other things, and the wall is drawn last
+			if (st->wantids) {
+				ID id = (ID)in->id;
+				int end = in->end;
+				if (ID_TYPE(id) == ID_TYPE_RECT && !st->infos[id].rcache.rect->img)
+					end = min(end + 1, st->idbufw);   // rect3_drawrow() draws these up to xmax, including xmax
+				ID *row = &st->idbuf[y*st->idbufw];
+				for (int x = in->start; x < end; x++)
+					row[x] = id;
+			}
+		}
 	}
 }
+
+void showall_enable_idbuffer(struct ShowAllContext *ctx)
+{
+	ctx->st.wantids = true;
+}
+
+enum ShowAllObject showall_object_at(const struct ShowAllContext *ctx, int x, int y, int *idx)
+{
+	const struct ShowingState *st = &ctx->st;
+	if (!st->wantids || x < 0 || x >= st->idbufw || y < 0 || y >= st->idbufh)
+		return SHOWALL_NOTHING;
+
+	ID id = st->idbuf[y*st->idbufw + x];
+	if (id == ID_NONE)
+		return SHOWALL_NOTHING;
+	*idx = (int)ID_INDEX(id);
+	return ID_TYPE(id) == ID_TYPE_RECT ? SHOWALL_RECT : SHOWALL_ELLIPSOID;
+}
+
+void show_all(
+	struct ShowAllContext *ctx,
+	const struct Rect3 *rects, int nrects, const struct WallGrid *grid,
+	const struct EllipsoidSpan *spans, int nspans,
+	const struct Camera *cam)
+{
+	struct ShowAllWorld *world = ctx ? &ctx->world : &tmpctx.world;
+	showall_world_update(world, rects, nrects, grid, spans, nspans);
+	showall_draw(ctx, world, cam);
+}
@@ -3,13 +3,99 @@
 #ifndef SHOWALL_H
 #define SHOWALL_H
 
+#include <stdbool.h>
 #include "camera.h"
 #include "ellipsoid.h"
 #include "rect3.h"
+#include "wallgrid.h"
 
+struct ShowAllContext;  // IWYU pragma: keep
+struct ShowAllWorld;  // IWYU pragma: keep
+
+/*
+Ellipsoids are in several arrays (players, enemies, guards, ...), and show_all()
+reads them where they are, so that they don't need to be copied into one big
+array on each frame.
+*/
+struct EllipsoidSpan {
+	const struct Ellipsoid *els;
+	int nels;
+
+	/*
+	If stacked is true, the ellipsoids must be the same except for center.y,
+	from bottom to top, like what guard_create_picked() makes. Then they are
+	shown as one object, which is much faster than sorting each of them with
+	everything else. Each ellipsoid still gets its own mip level and fading
+	near the far plane, but stacks are never drawn with impostors.
+	*/
+	bool stacked;
+};
+
+/*
+Remembers things between frames, so that show_all() doesn't need to figure out
+everything again when not much changed. Use a separate context for each camera.
+Use showall_context_free() when done.
+*/
+struct ShowAllContext *showall_context_new(void);
+void showall_context_free(struct ShowAllContext *ctx);
+
+/*
+Makes show_all() and showall_draw() with this context remember which object
+was drawn last to each pixel. This makes finding the object under the mouse
+just one lookup, no matter how many objects there are.
+*/
+void showall_enable_idbuffer(struct ShowAllContext *ctx);
+
+enum ShowAllObject { SHOWALL_NOTHING, SHOWALL_RECT, SHOWALL_ELLIPSOID };
+
+/*
+What was drawn last to pixel (x,y) of the camera's surface, when drawing with
+ctx last time. Sets idx to index of the rect, or index of the ellipsoid counting
+through all spans, like spans[0].els[0], ..., spans[1].els[0], ... A stack is
+one object, and its index is the index of the bottom ellipsoid. Always returns
+SHOWALL_NOTHING if showall_enable_idbuffer() wasn't called.
+*/
+enum ShowAllObject showall_object_at(const struct ShowAllContext *ctx, int x, int y, int *idx);
+
+// For debugging: check that remembering things gives same dependencies and a valid order of drawing (slow)
+extern bool showall_crosscheck;
+
+/*
+With many cameras, drawing goes in two stages. Once per frame,
+showall_world_update() does the work that doesn't depend on the camera, such as
+the planes of walls. Then showall_draw() draws for each camera.
+
+Different cameras can call showall_draw() in parallel from different threads,
+as long as each camera has its own context and nothing changes the world
+until they are all done. Use showall_world_free() when done.
+*/
+struct ShowAllWorld *showall_world_new(void);
+void showall_world_free(struct ShowAllWorld *world);
+
+/*
+The first grid->nwalls rects must be the walls in the grid. Other rects, such
+as jumpers, are always checked one by one. The grid can be NULL, and then all
+rects are checked one by one.
+
+Nothing is copied, so rects and spans must stay alive while drawing.
+*/
+void showall_world_update(
+	struct ShowAllWorld *world,
+	const struct Rect3 *rects, int nrects, const struct WallGrid *grid,
+	const struct EllipsoidSpan *spans, int nspans);
+
+/*
+If ctx is NULL, nothing is remembered and everything is computed from scratch.
+Only one thread at a time can do that, because then arrays are reused from a
+static context.
+*/
+void showall_draw(struct ShowAllContext *ctx, const struct ShowAllWorld *world, const struct Camera *cam);
+
+// Both stages at once, for when there is only one camera. Arguments are like above.
 void show_all(
-	const struct Rect3 *rects, int nrects,
-	const struct Ellipsoid *els, int nels,
+	struct ShowAllContext *ctx,
+	const struct Rect3 *rects, int nrects, const struct WallGrid *grid,
+	const struct EllipsoidSpan *spans, int nspans,
 	const struct Camera *cam
 );
 
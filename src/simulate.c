@@ -0,0 +1,244 @@
+#include "simulate.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <SDL2/SDL.h>
+#include "camera.h"
+#include "gamestate.h"
+#include "log.h"
+#include "map.h"
+#include "max.h"
+#include "misc.h"
+#include "prng.h"
+#include "profiler.h"
+#include "recording.h"
+
+// players can avoid enemies for a very long time, but not forever
+#define MAX_GAME_SECONDS (30*60)
+
+// on average, each player changes state of some key this many times per second
+#define KEY_CHANGES_PER_SECOND 3
+
+#define MAX_THREADS 64
+
+struct GameResult {
+	int winner;   // -1 for timeout
+	unsigned ticks;
+	int maxenemies, max_unpicked_guards;
+};
+
+// Each thread picks the next game that nobody is playing yet
+struct SimulationJob {
+	const struct Map *map;
+	const struct GameState *start;   // NULL to start games from the beginning
+	uint64_t seed;
+	bool huntingenemies;   // ignored when continuing from a snapshot
+	int nplayers;   // ignored when continuing from a snapshot
+	int ngames;
+	SDL_atomic_t nextgame;
+	struct GameResult *results;
+};
+
+static void press_random_keys(struct GameState *gs, struct Prng *prng, bool (*keysdown)[PLAYER_NKEYS])
+{
+	for (int p = 0; p < gs->nplayers; p++) {
+		if (prng_int(prng, CAMERA_FPS) >= KEY_CHANGES_PER_SECOND)
+			continue;
+
+		enum PlayerKey k = prng_int(prng, PLAYER_NKEYS);
+		keysdown[p][k] = !keysdown[p][k];
+		gamestate_handle_key(gs, gamestate_player_keys[p][k], keysdown[p][k]);
+
+		// guards are dropped when pressing, release it right away
+		if (k == PLAYER_KEY_DROP && keysdown[p][k]) {
+			keysdown[p][k] = false;
+			gamestate_handle_key(gs, gamestate_player_keys[p][k], false);
+		}
+	}
+}
+
+static struct GameResult simulate_one_game(const struct SimulationJob *job, uint64_t seed)
+{
+	struct GameState *gs;
+	if (job->start) {
+		// Different games from the same snapshot differ only by the keys pressed
+		gs = gamestate_copy(job->start);
+	} else {
+		gs = gamestate_new(job->map, NULL, job->nplayers, seed, job->huntingenemies);
+	}
+
+	// Key presses must not use the game's prng, because then they would affect the game
+	struct Prng keyprng;
+	prng_seed(&keyprng, ~seed);
+	bool keysdown[MAX_PLAYERS][PLAYER_NKEYS] = {0};
+
+	struct GameResult res = {0};
+	while (gamestate_winner(gs) == -1 && gs->thisframe < MAX_GAME_SECONDS*CAMERA_FPS) {
+		press_random_keys(gs, &keyprng, keysdown);
+		gamestate_eachframe(gs);
+		res.maxenemies = max(res.maxenemies, gs->nenemies);
+		res.max_unpicked_guards = max(res.max_unpicked_guards, gs->unpicked_guards.n);
+	}
+
+	res.winner = gamestate_winner(gs);
+	res.ticks = gs->thisframe - (job->start ? job->start->thisframe : 0);
+	gamestate_free(gs);
+	return res;
+}
+
+static int simulation_thread(void *jobptr)
+{
+	struct SimulationJob *job = jobptr;
+	int g;
+	while ((g = SDL_AtomicAdd(&job->nextgame, 1)) < job->ngames)
+		job->results[g] = simulate_one_game(job, job->seed + (uint64_t)g);
+	return 0;
+}
+
+static void print_results(const char *mapname, int nplayers, const struct GameResult *results, int ngames, double secs)
+{
+	int wins[MAX_PLAYERS] = {0}, timeouts = 0;
+	uint64_t ticks = 0;
+	unsigned minticks = ~0u, maxticks = 0;
+	int maxenemies = 0, max_unpicked_guards = 0;
+
+	for (const struct GameResult *r = results; r < &results[ngames]; r++) {
+		if (r->winner == -1)
+			timeouts++;
+		else
+			wins[r->winner]++;
+		ticks += r->ticks;
+		minticks = min(minticks, r->ticks);
+		maxticks = max(maxticks, r->ticks);
+		maxenemies = max(maxenemies, r->maxenemies);
+		max_unpicked_guards = max(max_unpicked_guards, r->max_unpicked_guards);
+	}
+
+	printf("%s: %d games", mapname, ngames);
+	for (int p = 0; p < nplayers; p++)
+		printf(", player %d won %d", p, wins[p]);
+	printf(", %d timeouts\n", timeouts);
+	printf("    game length in seconds: average %.1f, min %.1f, max %.1f\n",
+		(double)ticks / ngames / CAMERA_FPS,
+		(double)minticks / CAMERA_FPS,
+		(double)maxticks / CAMERA_FPS);
+	printf("    at most %d enemies and %d unpicked guards\n", maxenemies, max_unpicked_guards);
+	printf("    %.0f ticks per second\n", (double)ticks / secs);
+}
+
+static int get_thread_count(int ngames)
+{
+	int nthreads = SDL_GetCPUCount();
+	clamp(&nthreads, 1, min(MAX_THREADS, ngames));
+	return nthreads;
+}
+
+// Returns how many seconds it took
+static double run_job(struct SimulationJob *job, int nthreads)
+{
+	uint64_t start = SDL_GetPerformanceCounter();
+
+	SDL_Thread *threads[MAX_THREADS];
+	for (int t = 0; t < nthreads; t++) {
+		threads[t] = SDL_CreateThread(simulation_thread, "simulation", job);
+		if (!threads[t])
+			log_printf_abort("SDL_CreateThread failed: %s", SDL_GetError());
+	}
+	for (int t = 0; t < nthreads; t++)
+		SDL_WaitThread(threads[t], NULL);
+
+	return (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+}
+
+void simulate_games(const struct Map *maps, int nmaps, int ngames, int nplayers, bool huntingenemies)
+{
+	int nthreads = get_thread_count(ngames);
+	uint64_t seed = (uint64_t)time(NULL);
+	printf("Simulating %d players with %d threads, seed %llu%s\n",
+		nplayers, nthreads, (unsigned long long)seed, huntingenemies ? ", hunting enemies" : "");
+
+	struct GameResult *results = malloc(sizeof(results[0]) * ngames);
+	if (!results)
+		log_printf_abort("not enough memory for %d game results", ngames);
+
+	// Logging every bump into a file would be slower than everything else together
+	SDL_LogPriority oldprio = SDL_LogGetPriority(SDL_LOG_CATEGORY_APPLICATION);
+	SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_ERROR);
+
+	uint64_t totalticks = 0;
+	uint64_t starttime = SDL_GetPerformanceCounter();
+
+	for (int m = 0; m < nmaps; m++) {
+		struct SimulationJob job = { .map = &maps[m], .seed = seed, .huntingenemies = huntingenemies, .nplayers = nplayers, .ngames = ngames, .results = results };
+		double secs = run_job(&job, nthreads);
+		print_results(maps[m].name, nplayers, results, ngames, secs);
+		for (int g = 0; g < ngames; g++)
+			totalticks += results[g].ticks;
+	}
+
+	double secs = (double)(SDL_GetPerformanceCounter() - starttime) / (double)SDL_GetPerformanceFrequency();
+	printf("Total: %llu ticks in %.2f seconds, %.0f ticks per second\n",
+		(unsigned long long)totalticks, secs, (double)totalticks / secs);
+
+	SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, oldprio);
+	free(results);
+}
+
+void simulate_from_snapshot(const struct GameState *start, int ngames)
+{
+	int nthreads = get_thread_count(ngames);
+	uint64_t seed = (uint64_t)time(NULL);
+	printf("Simulating from frame %u with %d threads, seed %llu\n",
+		start->thisframe, nthreads, (unsigned long long)seed);
+
+	struct GameResult *results = malloc(sizeof(results[0]) * ngames);
+	if (!results)
+		log_printf_abort("not enough memory for %d game results", ngames);
+
+	SDL_LogPriority oldprio = SDL_LogGetPriority(SDL_LOG_CATEGORY_APPLICATION);
+	SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_ERROR);
+
+	struct SimulationJob job = { .map = start->map, .start = start, .seed = seed, .ngames = ngames, .results = results };
+	double secs = run_job(&job, nthreads);
+	print_results(start->map->name, start->nplayers, results, ngames, secs);
+
+	SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, oldprio);
+	free(results);
+}
+
+void simulate_replay(const struct Recording *rec, const struct Map *map, unsigned stopframe)
+{
+	struct GameState *gs = gamestate_new(map, NULL, rec->nplayers, rec->seed, rec->huntingenemies);
+	int keyidx = 0;
+
+	SDL_LogPriority oldprio = SDL_LogGetPriority(SDL_LOG_CATEGORY_APPLICATION);
+	SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_ERROR);
+	profiler_enable(true);
+	uint64_t start = SDL_GetPerformanceCounter();
+
+	while (gamestate_winner(gs) == -1 && gs->thisframe < stopframe) {
+		recording_apply_keys(rec, gs, &keyidx);
+		uint64_t framestart = profiler_start();
+		gamestate_eachframe(gs);
+		profiler_stop("game logic", framestart);
+	}
+
+	double secs = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+	profiler_enable(false);
+	SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, oldprio);
+
+	if (gamestate_winner(gs) == -1)
+		printf("Stopped at frame %u, ", gs->thisframe);
+	else
+		printf("Player %d won at frame %u, ", gamestate_winner(gs), gs->thisframe);
+	printf("%d enemies, %d unpicked guards", gs->nenemies, gs->unpicked_guards.n);
+	for (int p = 0; p < gs->nplayers; p++)
+		printf(", player %d has %d guards", p, gs->players[p].nguards);
+	printf("\n");
+	printf("%.0f ticks per second\n\n", (double)gs->thisframe / secs);
+	profiler_dump(stdout);
+
+	gamestate_free(gs);
+}
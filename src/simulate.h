@@ -0,0 +1,33 @@
+/*
+Playing the game without a window, as fast as the computer can. Players press
+random keys. This is handy for benchmarking the game logic, and for checking
+how long games usually last with different maps and spawning delays.
+
+Games run in parallel on all CPU cores. Each game gets its own seed, so the
+results don't depend on which thread happens to play which game.
+*/
+
+#ifndef SIMULATE_H
+#define SIMULATE_H
+
+#include <stdbool.h>
+#include "gamestate.h"
+#include "map.h"
+#include "recording.h"
+
+// Plays ngames games on each map, prints results to stdout
+void simulate_games(const struct Map *maps, int nmaps, int ngames, int nplayers, bool huntingenemies);
+
+/*
+Like simulate_games(), but all games continue from the same snapshot (see
+snapshot.h) instead of starting from the beginning.
+*/
+void simulate_from_snapshot(const struct GameState *start, int ngames);
+
+/*
+Plays a recorded game as fast as possible, until it ends or until frame number
+stopframe. Prints the result and profiler data to stdout.
+*/
+void simulate_replay(const struct Recording *rec, const struct Map *map, unsigned stopframe);
+
+#endif   // SIMULATE_H
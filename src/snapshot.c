@@ -0,0 +1,354 @@
+#include "snapshot.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <SDL2/SDL.h>
+#include "camera.h"
+#include "ellipsoid.h"
+#include "enemy.h"
+#include "gamestate.h"
+#include "guard.h"
+#include "log.h"
+#include "map.h"
+#include "max.h"
+#include "misc.h"
+#include "player.h"
+
+#define MAGIC "3DGSNAP"
+#define VERSION 5
+
+// There's no max number of enemies or guards, but a broken file shouldn't allocate gigabytes
+#define MAX_COUNT 1000000
+
+static void write_vec3(FILE *f, Vec3 v)
+{
+	write_float(f, v.x);
+	write_float(f, v.y);
+	write_float(f, v.z);
+}
+
+// Everything except the picture, because different kinds of ellipsoids store it differently
+static void write_ellipsoid(FILE *f, const struct Ellipsoid *el)
+{
+	write_vec3(f, el->center);
+	write_float(f, el->angle);
+	write_float(f, el->xzradius);
+	write_float(f, el->yradius);
+	write_number(f, el->hidelowerhalf, 1);
+	write_number(f, el->highlighted, 1);
+}
+
+static void write_jumpstate(FILE *f, const struct EllipsoidJumpState *js)
+{
+	write_float(f, js->xzspeed);
+	write_vec3(f, js->speed);
+	write_number(f, js->jumping, 1);
+}
+
+static void write_player(FILE *f, const struct Player *plr)
+{
+	write_ellipsoid(f, &plr->ellipsoid);
+	write_string(f, plr->ellipsoid.epic ? plr->ellipsoid.epic->path : "");
+	write_jumpstate(f, &plr->jumpstate);
+	write_vec3(f, plr->cam.location);
+	write_float(f, plr->cam.angle);
+	write_number(f, (uint64_t)(int64_t)plr->turning, 1);
+	write_number(f, plr->moving, 1);
+	write_number(f, plr->flat, 1);
+	write_vec3(f, plr->speed);
+	write_number(f, (uint64_t)(int64_t)plr->nguards, 4);
+}
+
+static void write_enemy(FILE *f, const struct Enemy *en, const struct Ellipsoid *el)
+{
+	write_ellipsoid(f, el);
+	write_string(f, el->epic ? el->epic->path : "");
+	write_jumpstate(f, &en->jumpstate);
+	write_number(f, en->flags, 1);
+	write_number(f, en->dir, 1);
+}
+
+bool snapshot_write(const struct GameState *gs, const char *path)
+{
+	FILE *f = fopen(path, "wb");
+	if (!f) {
+		log_printf("opening \"%s\" failed: %s", path, strerror(errno));
+		return false;
+	}
+
+	fwrite(MAGIC, 1, strlen(MAGIC), f);
+	write_number(f, VERSION, 1);
+	write_string(f, gs->map->path);
+	for (int i = 0; i < 4; i++)
+		write_number(f, gs->prng.s[i], 8);
+	write_number(f, gs->thisframe, 4);
+	write_number(f, gs->lastenemyframe, 4);
+	write_number(f, gs->lastguardframe, 4);
+	write_number(f, gs->huntingenemies, 1);
+
+	write_number(f, (uint64_t)gs->nplayers, 1);
+	for (int i = 0; i < gs->nplayers; i++)
+		write_player(f, &gs->players[i]);
+
+	write_number(f, (uint64_t)gs->nenemies, 4);
+	for (int i = 0; i < gs->nenemies; i++)
+		write_enemy(f, &gs->enemies[i], &gs->enemyels[i]);
+
+	write_number(f, (uint64_t)gs->unpicked_guards.n, 4);
+	for (int i = 0; i < gs->unpicked_guards.n; i++)
+		write_ellipsoid(f, &gs->unpicked_guards.els[i]);
+
+	write_number(f, (uint64_t)gs->map->njumpers, 2);
+	for (int i = 0; i < gs->map->njumpers; i++) {
+		write_float(f, gs->jumpers[i].y);
+		write_number(f, gs->jumpers[i].highlight, 1);
+	}
+
+	bool ok = !ferror(f);
+	if (fclose(f) != 0)
+		ok = false;
+	if (!ok) {
+		log_printf("writing \"%s\" failed", path);
+		return false;
+	}
+	log_printf("saved snapshot of frame %u to \"%s\"", gs->thisframe, path);
+	return true;
+}
+
+bool snapshot_save(const struct GameState *gs)
+{
+	my_mkdir("snapshots");
+
+	char path[100] = {0};
+	size_t len = strftime(
+		path, sizeof(path)-1,
+		"snapshots/%Y-%m-%d-%H%M%S",
+		localtime((time_t[]){ time(NULL) })
+	);
+	snprintf(path + len, sizeof(path) - len, "-frame%u.snap", gs->thisframe);
+	return snapshot_write(gs, path);
+}
+
+// Instead of checking each read separately, we check 'ok' once in the end
+struct Reader {
+	FILE *f;
+	bool ok;
+};
+
+static uint64_t get_number(struct Reader *r, int nbytes)
+{
+	uint64_t val;
+	if (!read_number(r->f, &val, nbytes)) {
+		r->ok = false;
+		return 0;
+	}
+	return val;
+}
+
+// for numbers that were written from negative ints
+static int get_signed(struct Reader *r, int nbytes)
+{
+	uint64_t val = get_number(r, nbytes);
+	if (nbytes < 8 && (val >> (8*nbytes - 1)))
+		val |= ~(uint64_t)0 << (8*nbytes);   // sign extend
+	return (int)(int64_t)val;
+}
+
+static float get_float(struct Reader *r)
+{
+	float val;
+	if (!read_float(r->f, &val)) {
+		r->ok = false;
+		return 0;
+	}
+	return val;
+}
+
+static Vec3 get_vec3(struct Reader *r)
+{
+	float x = get_float(r);
+	float y = get_float(r);
+	float z = get_float(r);
+	return (Vec3){x,y,z};
+}
+
+static void get_string(struct Reader *r, char *buf, size_t bufsize)
+{
+	if (!read_string(r->f, buf, bufsize)) {
+		r->ok = false;
+		buf[0] = '\0';
+	}
+}
+
+static void read_ellipsoid(struct Reader *r, struct Ellipsoid *el, const struct EllipsoidPic *epic)
+{
+	el->center = get_vec3(r);
+	el->epic = epic;
+	el->angle = get_float(r);
+	el->xzradius = get_float(r);
+	el->yradius = get_float(r);
+	el->hidelowerhalf = get_number(r, 1);
+	el->highlighted = get_number(r, 1);
+	ellipsoid_update_transforms(el);
+}
+
+static void read_jumpstate(struct Reader *r, struct EllipsoidJumpState *js)
+{
+	js->xzspeed = get_float(r);
+	js->speed = get_vec3(r);
+	js->jumping = get_number(r, 1);
+}
+
+static void read_player(struct Reader *r, struct Player *plr)
+{
+	read_ellipsoid(r, &plr->ellipsoid, NULL);
+
+	char path[sizeof plr->ellipsoid.epic->path];
+	get_string(r, path, sizeof path);
+	if (path[0])
+		plr->ellipsoid.epic = player_find_epic(path);
+	read_jumpstate(r, &plr->jumpstate);
+
+	plr->cam.location = get_vec3(r);
+	plr->cam.angle = get_float(r);
+	camera_update_caches(&plr->cam);
+
+	plr->turning = get_signed(r, 1);
+	plr->moving = get_number(r, 1);
+	plr->flat = get_number(r, 1);
+	plr->speed = get_vec3(r);
+	plr->nguards = get_signed(r, 4);
+}
+
+static void read_enemy(struct Reader *r, struct Enemy *en, struct Ellipsoid *el, const struct Map *map)
+{
+	read_ellipsoid(r, el, NULL);
+
+	char path[sizeof el->epic->path];
+	get_string(r, path, sizeof path);
+	if (path[0])
+		el->epic = enemy_find_epic(path);
+	read_jumpstate(r, &en->jumpstate);
+
+	en->map = map;
+	en->flags = (enum EnemyFlags)get_number(r, 1);
+	en->dir = (enum EnemyDir)get_number(r, 1);
+}
+
+// Doesn't read all the things, use 'ok' for checking that it's fine to continue
+static int read_count(struct Reader *r, int nbytes, int max, const char *what)
+{
+	uint64_t n = get_number(r, nbytes);
+	if (n > (uint64_t)max) {
+		log_printf("too many %s in snapshot: %llu > %d", what, (unsigned long long)n, max);
+		r->ok = false;
+		return 0;
+	}
+	return (int)n;
+}
+
+static void read_gamestate(struct Reader *r, struct GameState *gs)
+{
+	for (int i = 0; i < 4; i++)
+		gs->prng.s[i] = get_number(r, 8);
+	gs->thisframe = (unsigned)get_number(r, 4);
+	gs->lastenemyframe = (unsigned)get_number(r, 4);
+	gs->lastguardframe = (unsigned)get_number(r, 4);
+	gs->huntingenemies = get_number(r, 1);   // flow field gets computed when needed
+
+	gs->nplayers = read_count(r, 1, MAX_PLAYERS, "players");
+	if (r->ok && gs->nplayers < 2) {
+		log_printf("snapshot has %d players, need at least 2", gs->nplayers);
+		r->ok = false;
+	}
+	for (int i = 0; r->ok && i < gs->nplayers; i++)
+		read_player(r, &gs->players[i]);
+
+	gs->nenemies = read_count(r, 4, MAX_COUNT, "enemies");
+	gamestate_reserve_enemies(gs, gs->nenemies);
+	for (int i = 0; r->ok && i < gs->nenemies; i++)
+		read_enemy(r, &gs->enemies[i], &gs->enemyels[i], gs->map);
+
+	gs->unpicked_guards.n = read_count(r, 4, MAX_COUNT, "unpicked guards");
+	guard_reserve_unpickeds(&gs->unpicked_guards, gs->unpicked_guards.n);
+	for (int i = 0; r->ok && i < gs->unpicked_guards.n; i++)
+		read_ellipsoid(r, &gs->unpicked_guards.els[i], guard_get_epic());
+	guard_reindex_unpickeds(&gs->unpicked_guards);
+
+	int njumpers = read_count(r, 2, MAX_JUMPERS, "jumpers");
+	if (r->ok && njumpers != gs->map->njumpers) {
+		log_printf("map has %d jumpers, but snapshot has %d, maybe the map has been edited?",
+			gs->map->njumpers, njumpers);
+		r->ok = false;
+	}
+	for (int i = 0; r->ok && i < njumpers; i++) {
+		// separate statements, because order of evaluating initializers is unspecified
+		float y = get_float(r);
+		bool highlight = get_number(r, 1);
+		gs->jumpers[i] = (struct Jumper){
+			.x = gs->map->jumperlocs[i].x,
+			.z = gs->map->jumperlocs[i].z,
+			.y = y,
+			.highlight = highlight,
+		};
+	}
+}
+
+struct GameState *snapshot_load(const char *path, const struct Map *maps, int nmaps)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		log_printf("opening \"%s\" failed: %s", path, strerror(errno));
+		return NULL;
+	}
+
+	char magic[sizeof MAGIC] = {0};
+	uint64_t version;
+	if (fread(magic, 1, strlen(MAGIC), f) != strlen(MAGIC) || strcmp(magic, MAGIC) != 0
+			|| !read_number(f, &version, 1) || version != VERSION) {
+		log_printf("\"%s\" is not a snapshot file, or it's from a different version of the game", path);
+		fclose(f);
+		return NULL;
+	}
+
+	char mappath[sizeof maps[0].path];
+	if (!read_string(f, mappath, sizeof mappath)) {
+		log_printf("\"%s\" is truncated", path);
+		fclose(f);
+		return NULL;
+	}
+
+	const struct Map *map = NULL;
+	for (int i = 0; i < nmaps; i++) {
+		if (!strcmp(maps[i].path, mappath))
+			map = &maps[i];
+	}
+	if (!map) {
+		log_printf("snapshot \"%s\" uses map \"%s\", but it doesn't exist", path, mappath);
+		fclose(f);
+		return NULL;
+	}
+
+	// calloc because there's no other good way to zero-initialize a big struct without using stack
+	struct GameState *gs = calloc(1, sizeof(*gs));
+	if (!gs)
+		log_printf_abort("not enough memory for game state");
+	gs->map = map;
+
+	struct Reader r = { .f = f, .ok = true };
+	read_gamestate(&r, gs);
+	fclose(f);
+
+	if (!r.ok) {
+		log_printf("\"%s\" is truncated or broken", path);
+		gamestate_free(gs);
+		return NULL;
+	}
+	log_printf("loaded snapshot \"%s\": frame %u, %d enemies, %d unpicked guards",
+		path, gs->thisframe, gs->nenemies, gs->unpicked_guards.n);
+	return gs;
+}
@@ -0,0 +1,31 @@
+/*
+Saving a game in the middle and continuing it later. The slowest frames happen
+after minutes of playing, when there are lots of enemies and guards, and with
+snapshots, that can be benchmarked without playing for minutes first.
+
+Pictures and the map are stored as paths, and they are looked up when loading.
+Everything else is in a small binary file, similar to recordings (recording.h).
+*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include "gamestate.h"
+#include "map.h"
+
+// Returns false and logs a message on error
+bool snapshot_write(const struct GameState *gs, const char *path);
+
+// Saves to a new file in the snapshots directory (F9 in game)
+bool snapshot_save(const struct GameState *gs);
+
+/*
+Returns NULL and logs a message on error, e.g. if the map no longer exists.
+Pictures are NULL if they aren't loaded, just like with gamestate_new().
+
+Use gamestate_free() when done.
+*/
+struct GameState *snapshot_load(const char *path, const struct Map *maps, int nmaps);
+
+#endif   // SNAPSHOT_H
@@ -56,6 +56,10 @@ void sound_init(void)
 
 void sound_play(const char *fnpattern)
 {
+	// Don't glob files all the time with --no-sound, or when simulating games
+	if (nsounds == 0)
+		return;
+
 	char fullpat[1024];
 	snprintf(fullpat, sizeof fullpat, "assets/sounds/%s", fnpattern);
 
@@ -29,18 +29,12 @@ bool wall_match(const struct Wall *w1, const struct Wall *w2)
 
 
 /*
-I thought about doing collision checking by dividing it into these cases:
-- The ellipsoid could touch the corner points of the wall.
-- The ellipsoid could touch any edge of the wall so that it touches between the corners,
-  and doesn't touch the corners.
-- The ellipsoid could touch the "center part" of the wall without touching any edges or
-  corners.
-
-Handling all this would be a lot of code, so instead we just spread some points
-uniformly across the wall and see if those touch. I call these collision points.
+The ellipsoid is a ball with radius 1 in the coordinates that world2uball
+gives. Ellipsoids look the same from all xz directions, so rotating doesn't
+matter here, and it's enough to divide by the radiuses. Then the wall is still
+a rectangle with horizontal and vertical sides, and its closest point to the
+ellipsoid is found by clamping each coordinate into the wall.
 */
-#define COLLISION_POINT_COUNT 10
-
 void wall_bumps_ellipsoid(const struct Wall *w, struct Ellipsoid *el)
 {
 	/*
@@ -64,44 +58,41 @@ void wall_bumps_ellipsoid(const struct Wall *w, struct Ellipsoid *el)
 	if (vec3_lengthSQUARED(vec3_sub(el->center, wall_center(w))) > thing*thing)
 		return;
 
-	// Switch to coordinates where the ellipsoid is a ball with radius 1
-	Vec3 elcenter = mat3_mul_vec3(el->world2uball, el->center);
-
-	float c = 1.0f/(COLLISION_POINT_COUNT - 1);
-
-	for (int xznum = 0; xznum < COLLISION_POINT_COUNT; xznum++) {
-		for (int ynum = 0; ynum < COLLISION_POINT_COUNT; ynum++) {
-			Vec3 collpoint = { w->startx, Y_MIN+(Y_MAX-Y_MIN)*c*ynum, w->startz };
-			switch(w->dir) {
-				case WALL_DIR_XY: collpoint.x += xznum*c; break;
-				case WALL_DIR_ZY: collpoint.z += xznum*c; break;
-			}
-
-			Vec3 diff = vec3_sub(elcenter, mat3_mul_vec3(el->world2uball, collpoint));
-
-			float distSQUARED = vec3_lengthSQUARED(diff);
-			if (distSQUARED >= 1)   // doesn't bump
-				continue;
-
-			float dist = sqrtf(distSQUARED);
-
-			diff.y = 0;   // don't move up/down
-			diff = vec3_withlength(diff, 1 - dist);  // move just enough to not touch
-			vec3_apply_matrix(&diff, el->uball2world);
+	Vec3 closest = { (float)w->startx, el->center.y, (float)w->startz };
+	clamp_float(&closest.y, Y_MIN, Y_MAX);
+	switch(w->dir) {
+		case WALL_DIR_XY: closest.x = el->center.x; clamp_float(&closest.x, w->startx, w->startx + 1); break;
+		case WALL_DIR_ZY: closest.z = el->center.z; clamp_float(&closest.z, w->startz, w->startz + 1); break;
+	}
 
-			// if we're not bumping on the edge of the wall
-			if (xznum != 0 && xznum != COLLISION_POINT_COUNT - 1) {
-				// then we should move only in direction opposite to wall
-				switch(w->dir) {
-					case WALL_DIR_XY: diff.x = 0; break;
-					case WALL_DIR_ZY: diff.z = 0; break;
-				}
-			}
+	// from closest point to center, divided by radiuses
+	Vec3 diff = vec3_sub(el->center, closest);
+	float dx = diff.x / el->xzradius;
+	float dy = diff.y / el->yradius;
+	float dz = diff.z / el->xzradius;
+	float xzdistSQUARED = dx*dx + dz*dz;
+	if (xzdistSQUARED + dy*dy >= 1)   // doesn't bump
+		return;
 
-			vec3_add_inplace(&el->center, diff);
-			elcenter = mat3_mul_vec3(el->world2uball, el->center);   // cache invalidation
+	if (xzdistSQUARED < 1e-10f) {
+		// Center is on the wall. Move to the side of the wall where it is, or would be if it moved a little bit.
+		float sign = wall_side(w, el->center) ? 1 : -1;
+		switch(w->dir) {
+			case WALL_DIR_XY: diff.z = sign*el->xzradius; break;
+			case WALL_DIR_ZY: diff.x = sign*el->xzradius; break;
 		}
+		xzdistSQUARED = 1;
 	}
+
+	/*
+	Move horizontally away from the closest point, just enough to not touch
+	the wall. If the closest point isn't on an end of the wall, this moves in
+	the direction opposite to the wall, because then diff is perpendicular to
+	the wall.
+	*/
+	float scale = sqrtf((1 - dy*dy) / xzdistSQUARED);
+	el->center.x = closest.x + diff.x*scale;
+	el->center.z = closest.z + diff.z*scale;
 }
 
 Vec3 wall_center(const struct Wall *w)
@@ -0,0 +1,109 @@
+#include "wallgrid.h"
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "camera.h"
+#include "linalg.h"
+#include "max.h"
+#include "misc.h"
+#include "rect3.h"
+
+static void choose_chunk(struct WallGrid *grid, int idx)
+{
+	// Center of wall decides the chunk. Walls stick out of their chunks, but bounding boxes handle that.
+	const Vec3 *c = grid->corners[idx];
+	int x = (int)floorf((c[0].x + c[2].x) / 2 / WALLGRID_CHUNK_SIZE);
+	int z = (int)floorf((c[0].z + c[2].z) / 2 / WALLGRID_CHUNK_SIZE);
+	clamp(&x, 0, WALLGRID_NCHUNKS - 1);
+	clamp(&z, 0, WALLGRID_NCHUNKS - 1);
+	grid->chunkx[idx] = (unsigned char)x;
+	grid->chunkz[idx] = (unsigned char)z;
+}
+
+static void update_bounding_box(struct WallGrid *grid, int x, int z)
+{
+	struct WallGridChunk *ch = &grid->chunks[x][z];
+	ch->min = (Vec3){ HUGE_VALF, HUGE_VALF, HUGE_VALF };
+	ch->max = (Vec3){ -HUGE_VALF, -HUGE_VALF, -HUGE_VALF };
+
+	for (int i = ch->first - 1; i != -1; i = grid->next[i] - 1) {
+		for (int c = 0; c < 4; c++) {
+			Vec3 v = grid->corners[i][c];
+			ch->min = (Vec3){ min(ch->min.x, v.x), min(ch->min.y, v.y), min(ch->min.z, v.z) };
+			ch->max = (Vec3){ max(ch->max.x, v.x), max(ch->max.y, v.y), max(ch->max.z, v.z) };
+		}
+	}
+}
+
+static void add_to_chunk(struct WallGrid *grid, int idx)
+{
+	choose_chunk(grid, idx);
+	struct WallGridChunk *ch = &grid->chunks[grid->chunkx[idx]][grid->chunkz[idx]];
+	grid->next[idx] = ch->first;
+	ch->first = (short)(idx + 1);
+	update_bounding_box(grid, grid->chunkx[idx], grid->chunkz[idx]);
+}
+
+static void remove_from_chunk(struct WallGrid *grid, int idx)
+{
+	struct WallGridChunk *ch = &grid->chunks[grid->chunkx[idx]][grid->chunkz[idx]];
+	short *ptr = &ch->first;
+	while (*ptr != idx + 1) {
+		SDL_assert(*ptr != 0);
+		ptr = &grid->next[*ptr - 1];
+	}
+	*ptr = grid->next[idx];
+	update_bounding_box(grid, grid->chunkx[idx], grid->chunkz[idx]);
+}
+
+void wallgrid_update(struct WallGrid *grid, const struct Rect3 *walls, int nwalls)
+{
+	SDL_assert(nwalls <= MAX_WALLS);
+
+	for (int i = nwalls; i < grid->nwalls; i++)
+		remove_from_chunk(grid, i);
+
+	for (int i = 0; i < nwalls; i++) {
+		bool existed = (i < grid->nwalls);
+		if (existed && memcmp(grid->corners[i], walls[i].corners, sizeof(walls[i].corners)) == 0)
+			continue;
+
+		if (existed)
+			remove_from_chunk(grid, i);
+		memcpy(grid->corners[i], walls[i].corners, sizeof(walls[i].corners));
+		add_to_chunk(grid, i);
+	}
+
+	grid->nwalls = nwalls;
+}
+
+// Returns false if the whole box is on the invisible side of some plane of the camera
+static bool box_maybe_visible(Vec3 min, Vec3 max, const struct Camera *cam)
+{
+	for (int i = 0; i < sizeof(cam->visplanes)/sizeof(cam->visplanes[0]); i++) {
+		// Corner of box that is furthest to the visible side
+		Vec3 n = cam->visplanes[i].normal;
+		Vec3 corner = { n.x > 0 ? max.x : min.x, n.y > 0 ? max.y : min.y, n.z > 0 ? max.z : min.z };
+
+		// a little bit of extra, because floats aren't exact
+		if (vec3_dot(n, corner) < cam->visplanes[i].constant - 1e-4f)
+			return false;
+	}
+	return true;
+}
+
+void wallgrid_find_maybe_visible(const struct WallGrid *grid, const struct Camera *cam, bool *maybevisible)
+{
+	memset(maybevisible, 0, grid->nwalls * sizeof(maybevisible[0]));
+
+	for (int x = 0; x < WALLGRID_NCHUNKS; x++) {
+		for (int z = 0; z < WALLGRID_NCHUNKS; z++) {
+			const struct WallGridChunk *ch = &grid->chunks[x][z];
+			if (ch->first == 0 || !box_maybe_visible(ch->min, ch->max, cam))
+				continue;
+			for (int i = ch->first - 1; i != -1; i = grid->next[i] - 1)
+				maybevisible[i] = true;
+		}
+	}
+}
@@ -0,0 +1,62 @@
+/*
+Walls don't move while playing, so instead of checking each wall separately to
+see whether the camera can see it, we split the map into chunks of a few
+squares. If a chunk is entirely outside the view, none of its walls need to be
+checked.
+
+In the map editor, walls change all the time, and wallgrid_update() figures
+out which walls changed and updates only their chunks.
+
+Precomputing which map squares can be seen from which other squares (a
+"potentially visible set") doesn't help here. Walls are only 1 unit tall
+and the camera is about 4 units above the floor (see player.c), looking
+down over the walls, so a wall never hides everything behind it. The set
+of a square would contain almost the whole map. Culling by view direction
+is what actually removes walls, and that's what the chunks are for.
+*/
+
+#ifndef WALLGRID_H
+#define WALLGRID_H
+
+#include <stdbool.h>
+#include "camera.h"
+#include "linalg.h"
+#include "max.h"
+#include "rect3.h"
+
+// how many map squares each chunk has in x and z directions
+#define WALLGRID_CHUNK_SIZE 4
+
+// walls can be at the edge of the map, e.g. x = MAX_MAPSIZE
+#define WALLGRID_NCHUNKS (MAX_MAPSIZE/WALLGRID_CHUNK_SIZE + 1)
+
+// Indexes are stored plus one, so that a zero-initialized WallGrid is empty
+struct WallGridChunk {
+	short first;   // first wall of the chunk plus one, 0 if chunk is empty
+	Vec3 min, max;   // bounding box of all walls of the chunk
+};
+
+// This struct is big, don't put it on the stack
+struct WallGrid {
+	struct WallGridChunk chunks[WALLGRID_NCHUNKS][WALLGRID_NCHUNKS];
+	int nwalls;
+
+	// Indexed by wall index
+	short next[MAX_WALLS];   // next wall in the same chunk plus one, 0 for last
+	unsigned char chunkx[MAX_WALLS], chunkz[MAX_WALLS];
+	Vec3 corners[MAX_WALLS][4];   // for finding walls that changed
+};
+
+/*
+Make the grid contain the given walls. The first time, this adds all walls.
+After that, only walls that changed since the previous call are updated.
+*/
+void wallgrid_update(struct WallGrid *grid, const struct Rect3 *walls, int nwalls);
+
+/*
+Sets maybevisible[i] for each wall i. Walls that are not maybevisible are
+definitely not visible. Others may or may not be visible.
+*/
+void wallgrid_find_maybe_visible(const struct WallGrid *grid, const struct Camera *cam, bool *maybevisible);
+
+#endif   // WALLGRID_H
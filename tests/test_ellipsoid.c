@@ -0,0 +1,171 @@
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "../src/camera.h"
+#include "../src/ellipsoid.h"
+#include "../src/linalg.h"
+
+// How the matrices were calculated before, with the general matrix inverse
+static void check_transforms(const struct Ellipsoid *el)
+{
+	Mat3 scale = { .rows = {
+		{ el->xzradius, 0, 0 },
+		{ 0, el->yradius, 0 },
+		{ 0, 0, el->xzradius },
+	}};
+	Mat3 uball2world = mat3_mul_mat3(scale, mat3_rotation_xz(el->angle));
+	Mat3 world2uball = mat3_inverse(uball2world);
+
+	for (int i = 0; i < 3; i++) {
+		for (int k = 0; k < 3; k++) {
+			assert(fabsf(el->uball2world.rows[i][k] - uball2world.rows[i][k]) < 1e-5f);
+			assert(fabsf(el->world2uball.rows[i][k] - world2uball.rows[i][k]) < 1e-4f);
+		}
+	}
+}
+
+void test_ellipsoid_update_transforms(void)
+{
+	struct Ellipsoid els[20] = {0};
+	for (int i = 0; i < 20; i++) {
+		els[i].angle = (float)i - 10.3f;
+		els[i].xzradius = (i < 15) ? 0.3f : 0.45f;
+		els[i].yradius = (i < 15) ? 0.4f : 1.2f + (float)i/10;
+	}
+
+	struct Ellipsoid one[20];
+	memcpy(one, els, sizeof(els));
+	for (int i = 0; i < 20; i++) {
+		ellipsoid_update_transforms(&one[i]);
+		check_transforms(&one[i]);
+	}
+	ellipsoid_update_transforms_many(els, 20);
+	assert(memcmp(els, one, sizeof(els)) == 0);
+
+	// Nothing changes if angle and radii are the same
+	els[3].uball2world.rows[0][0] = 123;
+	ellipsoid_update_transforms(&els[3]);
+	ellipsoid_update_transforms_many(els, 20);
+	assert(els[3].uball2world.rows[0][0] == 123);
+
+	els[3].angle += 0.1f;
+	els[4].yradius *= 2;
+	ellipsoid_update_transforms_many(els, 20);
+	check_transforms(&els[3]);
+	check_transforms(&els[4]);
+}
+
+// Which impostor does a camera at the given direction from the ellipsoid get?
+static const uint32_t *impostor_seen_from(const struct Ellipsoid *el, float yaw, float pitch)
+{
+	struct Camera cam = {0};
+	cam.location = (Vec3){ 10*sinf(yaw)*cosf(pitch), 10*sinf(pitch), 10*cosf(yaw)*cosf(pitch) };
+	struct EllipsoidImpostor imp;
+	assert(ellipsoid_get_impostor(el, &cam, (SDL_Rect){ 10, 10, 20, 20 }, &imp));
+	assert(imp.left == 10 && imp.top == 10 && imp.width == 20 && imp.height == 20);
+	return imp.pixels;
+}
+
+void test_ellipsoid_impostor_directions(void)
+{
+	// Unit ball at origin, so world coordinates are unit ball coordinates
+	static struct EllipsoidPic epic;   // nothing loaded, only pointers are compared
+	struct Ellipsoid el = { .epic = &epic, .xzradius = 1, .yradius = 1 };
+	ellipsoid_update_transforms(&el);
+
+	float pi = acosf(-1);
+	float eps = 0.01f;
+	int middlepitch = ELLIPSOIDPIC_IMPOSTOR_NPITCHES/2;
+
+	for (int hl = 0; hl < 2; hl++) {
+		el.highlighted = hl;
+		for (int yaw = 0; yaw < ELLIPSOIDPIC_IMPOSTOR_NYAWS; yaw++) {
+			float edge = 2*pi*(float)yaw / ELLIPSOIDPIC_IMPOSTOR_NYAWS;
+			int before = (yaw + ELLIPSOIDPIC_IMPOSTOR_NYAWS - 1) % ELLIPSOIDPIC_IMPOSTOR_NYAWS;
+			assert(impostor_seen_from(&el, edge + eps, 0) == &epic.impostors[hl][yaw][middlepitch][0][0]);
+			assert(impostor_seen_from(&el, edge - eps, 0) == &epic.impostors[hl][before][middlepitch][0][0]);
+		}
+		for (int pitch = 1; pitch < ELLIPSOIDPIC_IMPOSTOR_NPITCHES; pitch++) {
+			float edge = -pi/2 + pi*(float)pitch / ELLIPSOIDPIC_IMPOSTOR_NPITCHES;
+			assert(impostor_seen_from(&el, 0, edge + eps) == &epic.impostors[hl][0][pitch][0][0]);
+			assert(impostor_seen_from(&el, 0, edge - eps) == &epic.impostors[hl][0][pitch-1][0][0]);
+		}
+	}
+
+	// Too big on screen
+	struct Camera cam = { .location = {0, 0, 10} };
+	struct EllipsoidImpostor imp;
+	assert(!ellipsoid_get_impostor(&el, &cam, (SDL_Rect){ 0, 0, ELLIPSOIDPIC_IMPOSTOR_SIZE + 1, 5 }, &imp));
+	cam.lodbias = 1;
+	assert(ellipsoid_get_impostor(&el, &cam, (SDL_Rect){ 0, 0, ELLIPSOIDPIC_IMPOSTOR_SIZE + 1, 5 }, &imp));
+}
+
+// Draws with two different background colors, so that any drawn color shows up at least once
+static void find_drawn_pixels(
+	const struct Ellipsoid *el, const struct Camera *cam, const struct EllipsoidImpostor *imp, bool *drawn)
+{
+	SDL_Surface *surf = cam->surface;
+	for (int i = 0; i < surf->w*surf->h; i++)
+		drawn[i] = false;
+
+	uint32_t backgrounds[] = { 0x000000, 0xffffff };
+	for (int b = 0; b < 2; b++) {
+		SDL_FillRect(surf, NULL, backgrounds[b]);
+		for (int y = 0; y < surf->h; y++) {
+			int xmin, xmax;
+			if (ellipsoid_xminmax(el, cam, y, &xmin, &xmax))
+				ellipsoid_drawrow_impostor(imp, cam, y, xmin, xmax);
+		}
+		for (int y = 0; y < surf->h; y++) {
+			for (int x = 0; x < surf->w; x++) {
+				if (((const uint32_t *)surf->pixels)[y*surf->pitch/4 + x] != backgrounds[b])
+					drawn[y*surf->w + x] = true;
+			}
+		}
+	}
+}
+
+void test_ellipsoid_impostor_covers_same_pixels(void)
+{
+	SDL_Surface *surf = SDL_CreateRGBSurfaceWithFormat(0, 200, 150, 32, SDL_PIXELFORMAT_RGB888);
+	assert(surf);
+	struct EllipsoidPic *epic = malloc(sizeof(*epic));
+	assert(epic);
+	ellipsoidpic_load(epic, "assets/guard.png", surf->format);
+
+	struct Camera cam = { .surface = surf, .screencentery = 40, .location = {0.5f, 1, 4} };
+	camera_update_caches(&cam);
+
+	// Far away, so that it's small on screen
+	struct Ellipsoid el = { .center = {1, 0.5f, -8}, .epic = epic, .angle = 1, .xzradius = 0.3f, .yradius = 0.4f };
+	ellipsoid_update_transforms(&el);
+	assert(ellipsoid_is_visible(&el, &cam));
+
+	struct EllipsoidImpostor imp;
+	SDL_Rect bbox = ellipsoid_bbox_unclipped(&el, &cam);
+	assert(ellipsoid_get_impostor(&el, &cam, bbox, &imp));
+
+	bool *drawn = malloc(surf->w * surf->h * sizeof(drawn[0]));
+	assert(drawn);
+	find_drawn_pixels(&el, &cam, &imp, drawn);
+
+	int ndrawn = 0;
+	for (int y = 0; y < surf->h; y++) {
+		int xmin = 0, xmax = 0;
+		if (!ellipsoid_xminmax(&el, &cam, y, &xmin, &xmax))
+			xmin = xmax = 0;
+		for (int x = 0; x < surf->w; x++) {
+			assert(drawn[y*surf->w + x] == (xmin <= x && x < xmax));
+			ndrawn += drawn[y*surf->w + x];
+		}
+	}
+	assert(ndrawn > 20);
+
+	free(drawn);
+	free(epic);
+	SDL_FreeSurface(surf);
+}
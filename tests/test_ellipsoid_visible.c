@@ -0,0 +1,77 @@
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include "../src/camera.h"
+#include "../src/ellipsoid.h"
+#include "../src/prng.h"
+
+#define N 1000
+
+void test_ellipsoid_visible_many_same_as_one_at_a_time(void)
+{
+	// Only width and height are needed for the visibility planes
+	SDL_Surface surf = { .w = 400, .h = 300 };
+	struct Camera cam = { .surface = &surf, .screencentery = 75, .location = {1, 4, 2}, .angle = 0.3f };
+	camera_update_caches(&cam);
+
+	struct Prng prng;
+	prng_seed(&prng, 1);
+
+	static struct Ellipsoid els[N];
+	for (int i = 0; i < N; i++) {
+		// not all in one initializer, because evaluation order would be unspecified
+		els[i].center.x = 40*prng_float(&prng) - 20;
+		els[i].center.y = 4*prng_float(&prng);
+		els[i].center.z = 40*prng_float(&prng) - 20;
+		els[i].angle = 6*prng_float(&prng);
+		els[i].xzradius = 0.1f + prng_float(&prng);
+		els[i].yradius = 0.1f + 2*prng_float(&prng);
+		ellipsoid_update_transforms(&els[i]);
+	}
+
+	static bool visible[N];
+	ellipsoid_visible_many(els, N, &cam, visible);
+
+	int nvisible = 0;
+	for (int i = 0; i < N; i++) {
+		assert(visible[i] == ellipsoid_is_visible(&els[i], &cam));
+		nvisible += visible[i];
+	}
+
+	// make sure that the test tests something
+	assert(nvisible > 10);
+	assert(nvisible < N - 10);
+}
+
+void test_ellipsoid_visible_far_plane(void)
+{
+	SDL_Surface surf = { .w = 400, .h = 300 };
+	struct Camera cam = { .surface = &surf, .screencentery = 150, .location = {0, 0, 0}, .angle = 0 };
+
+	// camera looks towards negative z
+	struct Ellipsoid els[] = {
+		{ .center = {0, 0, -5}, .xzradius = 1, .yradius = 1 },
+		{ .center = {0, 0, -20}, .xzradius = 1, .yradius = 1 },
+		{ .center = {0, 0, -10.5f}, .xzradius = 1, .yradius = 1 },   // partially beyond far plane
+	};
+	for (int i = 0; i < 3; i++)
+		ellipsoid_update_transforms(&els[i]);
+
+	float distances[] = { 0, 10 };
+	bool expected[][3] = {
+		{ true, true, true },
+		{ true, false, true },
+	};
+
+	for (int d = 0; d < 2; d++) {
+		cam.drawdistance = distances[d];
+		camera_update_caches(&cam);
+
+		bool visible[3];
+		ellipsoid_visible_many(els, 3, &cam, visible);
+		for (int i = 0; i < 3; i++) {
+			assert(visible[i] == expected[d][i]);
+			assert(ellipsoid_is_visible(&els[i], &cam) == expected[d][i]);
+		}
+	}
+}
@@ -66,3 +66,31 @@ void test_ellipsoid_bump_amount_hidelowerhalf_with_actual_ellipsoids(void)
 	assert(ellipsoid_bump_amount(&upper, &lower) == 0);
 	assert(ellipsoid_bump_amount(&lower, &upper) == 0);
 }
+
+void test_ellipsoid_bump_amount_many(void)
+{
+	struct Ellipsoid el = { .center = {0,0.5f,0}, .xzradius = 0.4f, .yradius = 0.7f };
+	ellipsoid_update_transforms(&el);
+
+	// more than one chunk, some bump and most don't
+	struct Ellipsoid others[40];
+	for (int i = 0; i < 40; i++) {
+		others[i] = (struct Ellipsoid){
+			.center = { 0.05f*i*cosf(i), 0.3f + 0.02f*i, 0.05f*i*sinf(i) },
+			.xzradius = 0.3f,
+			.yradius = 0.5f,
+			.hidelowerhalf = (i % 3 == 0),
+		};
+		ellipsoid_update_transforms(&others[i]);
+	}
+
+	float bumps[40];
+	ellipsoid_bump_amount_many(&el, others, 40, bumps);
+
+	int nbumps = 0;
+	for (int i = 0; i < 40; i++) {
+		assert(bumps[i] == ellipsoid_bump_amount(&el, &others[i]));
+		nbumps += (bumps[i] != 0);
+	}
+	assert(5 < nbumps && nbumps < 35);
+}
@@ -0,0 +1,89 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <SDL2/SDL.h>
+#include "../src/ellipsoid.h"
+#include "../src/misc.h"
+
+// Average of 2x2x2 pixels, like create_smaller_level() should compute it
+static uint32_t expected_average(const struct EllipsoidPic *epic, int level, int x, int y, int z)
+{
+	int bigside = ELLIPSOIDPIC_LEVEL_SIDE(level-1);
+	const uint32_t *big = ellipsoidpic_level(epic, false, level-1);
+	int rsum = 0, gsum = 0, bsum = 0;
+	for (int dx = 0; dx < 2; dx++)
+	for (int dy = 0; dy < 2; dy++)
+	for (int dz = 0; dz < 2; dz++)
+	{
+		int bx = min(2*x + dx, bigside-1);
+		int by = min(2*y + dy, bigside-1);
+		int bz = min(2*z + dz, bigside-1);
+		uint8_t r, g, b;
+		SDL_GetRGB(big[ellipsoidpic_index(ELLIPSOIDPIC_LEVEL_NBRICKS(level-1), bx, by, bz)], epic->pixfmt, &r, &g, &b);
+		rsum += r;
+		gsum += g;
+		bsum += b;
+	}
+	return SDL_MapRGB(epic->pixfmt, (uint8_t)(rsum/8), (uint8_t)(gsum/8), (uint8_t)(bsum/8));
+}
+
+static uint32_t get_pixel(const struct EllipsoidPic *epic, int level, int x, int y, int z)
+{
+	return ellipsoidpic_level(epic, false, level)[ellipsoidpic_index(ELLIPSOIDPIC_LEVEL_NBRICKS(level), x, y, z)];
+}
+
+void test_ellipsoidpic_mip_levels(void)
+{
+	assert(ELLIPSOIDPIC_LEVEL_SIDE(0) == 150);
+	assert(ELLIPSOIDPIC_LEVEL_SIDE(1) == 75);
+	assert(ELLIPSOIDPIC_LEVEL_SIDE(2) == 38);
+	assert(ELLIPSOIDPIC_LEVEL_SIDE(3) == 19);
+
+	struct EllipsoidPic *epic = malloc(sizeof(*epic));
+	assert(epic);
+	SDL_PixelFormat *fmt = SDL_AllocFormat(SDL_PIXELFORMAT_RGB888);
+	ellipsoidpic_load(epic, "assets/guard.png", fmt);
+
+	for (int level = 1; level < ELLIPSOIDPIC_NLEVELS; level++) {
+		int side = ELLIPSOIDPIC_LEVEL_SIDE(level);
+		assert(get_pixel(epic, level, 0, 0, 0) == expected_average(epic, level, 0, 0, 0));
+		assert(get_pixel(epic, level, side/2, 3, side/3) == expected_average(epic, level, side/2, 3, side/3));
+		// 75 -> 38 doesn't divide evenly, so last pixel of level 1 is used twice
+		assert(get_pixel(epic, level, side-1, side/2, side-1) == expected_average(epic, level, side-1, side/2, side-1));
+	}
+
+	// Odd edge by hand: last pixel of level 2 is 2x2 pixels of level 1 used twice
+	int r = 0, g = 0, b = 0;
+	for (int dy = 0; dy < 2; dy++)
+	for (int dz = 0; dz < 2; dz++)
+	{
+		uint8_t pr, pg, pb;
+		SDL_GetRGB(get_pixel(epic, 1, 74, 10 + dy, 20 + dz), epic->pixfmt, &pr, &pg, &pb);
+		r += 2*pr;
+		g += 2*pg;
+		b += 2*pb;
+	}
+	assert(get_pixel(epic, 2, 37, 5, 10) == SDL_MapRGB(epic->pixfmt, (uint8_t)(r/8), (uint8_t)(g/8), (uint8_t)(b/8)));
+
+	free(epic);
+	SDL_FreeFormat(fmt);
+}
+
+void test_ellipsoid_choose_miplevel(void)
+{
+	// Smallest level that has at least one pixel for each pixel on screen
+	assert(ellipsoid_choose_miplevel((SDL_Rect){ 0, 0, 10, 10 }, 0) == 3);
+	assert(ellipsoid_choose_miplevel((SDL_Rect){ 0, 0, 19, 5 }, 0) == 3);
+	assert(ellipsoid_choose_miplevel((SDL_Rect){ 0, 0, 5, 20 }, 0) == 2);
+	assert(ellipsoid_choose_miplevel((SDL_Rect){ 0, 0, 38, 38 }, 0) == 2);
+	assert(ellipsoid_choose_miplevel((SDL_Rect){ 0, 0, 39, 38 }, 0) == 1);
+	assert(ellipsoid_choose_miplevel((SDL_Rect){ 0, 0, 75, 75 }, 0) == 1);
+	assert(ellipsoid_choose_miplevel((SDL_Rect){ 0, 0, 76, 75 }, 0) == 0);
+	assert(ellipsoid_choose_miplevel((SDL_Rect){ -500, -500, 2000, 2000 }, 0) == 0);
+
+	// Each lod bias halves the size
+	assert(ellipsoid_choose_miplevel((SDL_Rect){ 0, 0, 76, 75 }, 1) == 2);
+	assert(ellipsoid_choose_miplevel((SDL_Rect){ 0, 0, 150, 150 }, 1) == 1);
+	assert(ellipsoid_choose_miplevel((SDL_Rect){ 0, 0, 150, 150 }, 2) == 2);
+	assert(ellipsoid_choose_miplevel((SDL_Rect){ 0, 0, 150, 150 }, 3) == 3);
+}
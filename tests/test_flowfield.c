@@ -0,0 +1,86 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "../src/enemy.h"
+#include "../src/flowfield.h"
+#include "../src/map.h"
+#include "../src/wall.h"
+
+// Wall splits the map, except at z=4. Square (4,2) can't be reached at all.
+static struct Map *create_test_map(void)
+{
+	struct Map *map = calloc(1, sizeof(*map));
+	assert(map);
+	map->xsize = 5;
+	map->zsize = 5;
+	for (int z = 0; z < 4; z++)
+		map_addwall(map, 2, z, WALL_DIR_ZY);
+
+	// square (4,2) is closed from all sides that aren't the edge of the map
+	map_addwall(map, 4, 2, WALL_DIR_XY);
+	map_addwall(map, 4, 3, WALL_DIR_XY);
+	map_addwall(map, 4, 2, WALL_DIR_ZY);
+	return map;
+}
+
+void test_flowfield_shortest_paths(void)
+{
+	struct Map *map = create_test_map();
+	struct FlowField *ff = calloc(1, sizeof(*ff));
+	assert(ff);
+
+	flowfield_update(ff, map, (Vec3[]){ {0.5f, 0, 0.5f} }, 1);
+	assert(ff->dist[0][0] == 0);
+	assert(ff->dist[1][4] == 5);
+	assert(ff->dist[4][0] == 12);   // around the wall
+	assert(ff->dist[4][2] == -1);
+	assert(flowfield_get_dir(ff, 0, 0) == -1);
+	assert(flowfield_get_dir(ff, 4, 2) == -1);
+	assert(flowfield_get_dir(ff, -1, 0) == -1);
+	assert(flowfield_get_dir(ff, 0, 5) == -1);
+
+	int xdiffs[4] = { [ENEMY_DIR_XPOS] = 1, [ENEMY_DIR_XNEG] = -1 };
+	int zdiffs[4] = { [ENEMY_DIR_ZPOS] = 1, [ENEMY_DIR_ZNEG] = -1 };
+
+	// Following the directions gets to the target without going through walls
+	for (int x = 0; x < 5; x++) {
+		for (int z = 0; z < 5; z++) {
+			if (ff->dist[x][z] <= 0)
+				continue;
+			int dir = flowfield_get_dir(ff, x, z);
+			assert(dir != -1);
+			assert(!(ff->blocked[x][z] & (1 << dir)));
+			assert(ff->dist[x + xdiffs[dir]][z + zdiffs[dir]] == ff->dist[x][z] - 1);
+		}
+	}
+
+	// Nearest of two targets
+	flowfield_update(ff, map, (Vec3[]){ {0.5f, 0, 0.5f}, {4.9f, 0, 0.1f} }, 2);
+	assert(ff->dist[4][0] == 0);
+	assert(ff->dist[3][4] == 5);
+	assert(ff->dist[0][4] == 4);
+
+	free(ff);
+	free(map);
+}
+
+void test_flowfield_recomputes_only_when_needed(void)
+{
+	struct Map *map = create_test_map();
+	struct FlowField *ff = calloc(1, sizeof(*ff));
+	assert(ff);
+
+	flowfield_update(ff, map, (Vec3[]){ {0.5f, 0, 0.5f}, {4.5f, 0, 4.5f} }, 2);
+	ff->dist[1][1] = 123;
+
+	// moving within the same squares
+	flowfield_update(ff, map, (Vec3[]){ {0.1f, 0, 0.9f}, {5, 0, 5} }, 2);
+	assert(ff->dist[1][1] == 123);
+
+	// one target moves to another square
+	flowfield_update(ff, map, (Vec3[]){ {0.1f, 0, 0.9f}, {3.9f, 0, 4.5f} }, 2);
+	assert(ff->dist[1][1] == 2);
+	assert(ff->dist[3][4] == 0);
+
+	free(ff);
+	free(map);
+}
@@ -0,0 +1,64 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "../src/gamestate.h"
+#include "../src/map.h"
+
+void test_gamestate_four_players(void)
+{
+	int nmaps;
+	struct Map *maps = map_list(&nmaps);
+	assert(nmaps > 0);
+
+	struct GameState *gs = gamestate_new(&maps[0], NULL, 4, 123, true);
+	assert(gs->nplayers == 4);
+
+	// Everyone starts at a different place
+	for (int i = 0; i < 4; i++) {
+		for (int k = i+1; k < 4; k++) {
+			Vec3 diff = vec3_sub(gs->players[i].ellipsoid.center, gs->players[k].ellipsoid.center);
+			assert(vec3_lengthSQUARED(diff) > 0.5f);
+		}
+	}
+
+	// Each player has their own keys, only player 3 moves
+	Vec3 start[4];
+	for (int i = 0; i < 4; i++)
+		start[i] = gs->players[i].ellipsoid.center;
+	assert(gamestate_handle_key(gs, gamestate_player_keys[3][PLAYER_KEY_MOVE], true));
+	for (int i = 0; i < 5; i++)
+		gamestate_eachframe(gs);
+	for (int i = 0; i < 4; i++) {
+		Vec3 c = gs->players[i].ellipsoid.center;
+		bool moved = (c.x != start[i].x || c.z != start[i].z);   // y changes anyway
+		assert(moved == (i == 3));
+	}
+
+	// When someone runs out of guards, the player with the most guards wins
+	assert(gamestate_winner(gs) == -1);
+	gs->players[0].nguards = 3;
+	gs->players[1].nguards = 5;
+	gs->players[2].nguards = -1;
+	gs->players[3].nguards = 5;
+	assert(gamestate_winner(gs) == 1);
+	gs->players[3].nguards = 6;
+	assert(gamestate_winner(gs) == 3);
+
+	gamestate_free(gs);
+	free(maps);
+}
+
+void test_gamestate_keys_of_missing_players(void)
+{
+	int nmaps;
+	struct Map *maps = map_list(&nmaps);
+	assert(nmaps > 0);
+
+	struct GameState *gs = gamestate_new(&maps[0], NULL, 2, 123, false);
+	assert(gamestate_handle_key(gs, gamestate_player_keys[1][PLAYER_KEY_LEFT], true));
+	assert(!gamestate_handle_key(gs, gamestate_player_keys[2][PLAYER_KEY_LEFT], true));
+	assert(!gamestate_handle_key(gs, gamestate_player_keys[3][PLAYER_KEY_DROP], true));
+
+	gamestate_free(gs);
+	free(maps);
+}
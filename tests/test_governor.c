@@ -0,0 +1,74 @@
+#include <assert.h>
+#include "../src/camera.h"
+#include "../src/governor.h"
+
+void test_governor_lowers_and_restores_quality(void)
+{
+	struct Governor gov = {0};
+	assert(governor_quality(&gov).resolution == 1);
+
+	// Way too slow, goes to worst quality one level at a time
+	int prevlevel = 0;
+	for (int i = 0; i < 5*CAMERA_FPS; i++) {
+		governor_update(&gov, 0.030f);
+		assert(gov.level == prevlevel || gov.level == prevlevel + 1);
+		prevlevel = gov.level;
+	}
+	assert(gov.level == GOVERNOR_NLEVELS - 1);
+	assert(governor_quality(&gov).resolution < 1);
+	assert(governor_quality(&gov).drawdistance > 0);
+
+	// Just a little slow but not lagging, stays where it is
+	for (int i = 0; i < 20*CAMERA_FPS; i++)
+		assert(!governor_update(&gov, 0.8f / CAMERA_FPS));
+	assert(gov.level == GOVERNOR_NLEVELS - 1);
+
+	// Fast again, goes back to full quality
+	for (int i = 0; i < 30*CAMERA_FPS; i++)
+		governor_update(&gov, 0.002f);
+	assert(gov.level == 0);
+	assert(governor_quality(&gov).resolution == 1);
+	assert(governor_quality(&gov).drawdistance == 0);
+}
+
+void test_governor_doesnt_flip_back_and_forth(void)
+{
+	// Full quality is too slow, and next level is fast enough to try full quality again
+	struct Governor gov = {0};
+	int nchanges = 0;
+	for (int i = 0; i < 120*CAMERA_FPS; i++) {
+		float frametime = (gov.level == 0) ? 0.020f : 0.005f;
+		if (governor_update(&gov, frametime))
+			nchanges++;
+	}
+
+	// Without waiting longer each time, it would change about 100 times
+	assert(nchanges < 25);
+}
+
+void test_governor_forgets_old_slowdowns(void)
+{
+	struct Governor gov = {0};
+	for (int i = 0; i < 60*CAMERA_FPS; i++)
+		governor_update(&gov, (gov.level == 0) ? 0.020f : 0.005f);
+	assert(gov.upwait > 2*CAMERA_FPS);
+
+	// Full quality becomes fast enough, eventually goes back and stays there
+	for (int i = 0; i < 60*CAMERA_FPS; i++)
+		governor_update(&gov, 0.005f);
+	assert(gov.level == 0);
+
+	// One more slowdown
+	while (gov.level == 0)
+		governor_update(&gov, 0.030f);
+	assert(gov.level == 1);
+
+	// Comes back after about 2 seconds, not 30 seconds
+	int frames = 0;
+	while (gov.level != 0) {
+		governor_update(&gov, 0.005f);
+		frames++;
+		assert(frames < 3*CAMERA_FPS);
+	}
+	assert(frames >= 2*CAMERA_FPS);
+}
@@ -0,0 +1,59 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/guard.h"
+#include "../src/linalg.h"
+#include "../src/prng.h"
+
+// How adding guards worked before the hash table, with a slow loop
+static Vec3 add_guard_slowly(Vec3 *centers, int *ncenters, Vec3 center)
+{
+	for (int i = 0; i < *ncenters; i++) {
+		if (vec3_lengthSQUARED(vec3_sub(center, centers[i])) < 0.001) {
+			center.y += 0.2f;
+			i = -1;   // start over
+		}
+	}
+	centers[(*ncenters)++] = center;
+	return center;
+}
+
+void test_guard_stacking_same_as_without_hash_table(void)
+{
+	// calloc because an empty UnpickedGuards is all zeros
+	struct UnpickedGuards *ug = calloc(1, sizeof(*ug));
+	static Vec3 centers[3000 + 1];
+	int ncenters = 0;
+	assert(ug);
+
+	// Few places, close to each other and to cell borders, so that stacks form and some touch
+	Vec3 places[] = { {1.5f,0,1.5f}, {1.52f,0,1.5f}, {1.6f,0,1.5f}, {2.0f,0,3.0f}, {2.0f,0,3.01f}, {0.06f,0,0.06f} };
+	struct Prng prng;
+	prng_seed(&prng, 123);
+
+	for (int iter = 0; iter < 3000; iter++) {
+		if (ug->n > 0 && prng_int(&prng, 3) == 0) {
+			int idx = prng_int(&prng, ug->n);
+			guard_remove_unpicked(ug, idx);
+			centers[idx] = centers[--ncenters];
+		} else {
+			Vec3 place = places[prng_int(&prng, sizeof(places)/sizeof(places[0]))];
+			guard_create_unpickeds_center(ug, 1, place);
+			add_guard_slowly(centers, &ncenters, place);
+		}
+
+		assert(ug->n == ncenters);
+		for (int i = 0; i < ncenters; i++)
+			assert(memcmp(&ug->els[i].center, &centers[i], sizeof(Vec3)) == 0);
+	}
+
+	// Rebuilding the hash table gives same results
+	guard_reindex_unpickeds(ug);
+	guard_create_unpickeds_center(ug, 1, places[0]);
+	Vec3 expected = add_guard_slowly(centers, &ncenters, places[0]);
+	assert(memcmp(&ug->els[ug->n - 1].center, &expected, sizeof(Vec3)) == 0);
+
+	guard_free_unpickeds(ug);
+	free(ug);
+}
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include "../src/interval.h"
 
 /*
@@ -100,10 +101,9 @@ void test_non_overlapping_bug(void)
 		{528, 599, 115, true},
 	};
 
-#define INLEN ( sizeof(in)/sizeof(in[0]) )
-	struct Interval out[INTERVAL_NON_OVERLAPPING_MAX(INLEN)];
-	int outlen = interval_non_overlapping(in, INLEN, out);
-#undef INLEN
+	struct Interval *out = NULL;
+	int outalloced = 0;
+	int outlen = interval_non_overlapping(in, sizeof(in)/sizeof(in[0]), &out, &outalloced);
 
 	struct Interval shouldB[] = {
 		{385, 393, 0, false},
@@ -117,4 +117,5 @@ void test_non_overlapping_bug(void)
 		out, outlen,
 		shouldB, sizeof(shouldB)/sizeof(shouldB[0])
 	));
+	free(out);
 }
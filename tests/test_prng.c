@@ -0,0 +1,41 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "../src/prng.h"
+
+void test_prng_same_seed_same_numbers(void)
+{
+	struct Prng a, b, c;
+	prng_seed(&a, 123);
+	prng_seed(&b, 123);
+	prng_seed(&c, 124);
+
+	bool allsame = true;
+	for (int i = 0; i < 1000; i++) {
+		uint64_t x = prng_next(&a);
+		assert(x == prng_next(&b));
+		if (x != prng_next(&c))
+			allsame = false;
+	}
+	assert(!allsame);
+}
+
+void test_prng_ranges(void)
+{
+	struct Prng prng;
+	prng_seed(&prng, 0);
+
+	int counts[5] = {0};
+	for (int i = 0; i < 5000; i++) {
+		int n = prng_int(&prng, 5);
+		assert(0 <= n && n < 5);
+		counts[n]++;
+
+		float f = prng_float(&prng);
+		assert(0 <= f && f < 1);
+	}
+
+	// very unlikely to fail by accident, this is about 10 standard deviations
+	for (int i = 0; i < 5; i++)
+		assert(800 < counts[i] && counts[i] < 1200);
+}
@@ -0,0 +1,227 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "../src/camera.h"
+#include "../src/ellipsoid.h"
+#include "../src/guard.h"
+#include "../src/rect3.h"
+#include "../src/showall.h"
+
+// Guard pictures can be loaded only once
+static void init_guard_epic(void)
+{
+	static bool ready = false;
+	if (!ready) {
+		guard_init_epic(SDL_AllocFormat(SDL_PIXELFORMAT_RGB888));
+		ready = true;
+	}
+}
+
+// For rects without image, rect3_drawrow() draws x=xmax too
+static bool rect_covers(const struct Rect3 *r, const struct Camera *cam, int x, int y)
+{
+	struct Rect3Cache rcache;
+	int xmin, xmax;
+	return rect3_visible_fillcache(r, cam, &rcache)
+		&& rcache.bbox.y <= y && y < rcache.bbox.y + rcache.bbox.h
+		&& rect3_xminmax(&rcache, y, &xmin, &xmax)
+		&& xmin <= x && x <= xmax;
+}
+
+static bool ellipsoid_covers(const struct Ellipsoid *el, const struct Camera *cam, int x, int y)
+{
+	int xmin, xmax;
+	SDL_Rect bbox = ellipsoid_bbox(el, cam);
+	return ellipsoid_is_visible(el, cam)
+		&& bbox.y <= y && y < bbox.y + bbox.h
+		&& ellipsoid_xminmax(el, cam, y, &xmin, &xmax)
+		&& xmin <= x && x < xmax;
+}
+
+void test_showall_idbuffer_has_object_drawn_last(void)
+{
+	SDL_Surface *surf = SDL_CreateRGBSurfaceWithFormat(0, 200, 150, 32, SDL_PIXELFORMAT_RGB888);
+	assert(surf);
+	init_guard_epic();
+
+	struct Camera cam = { .surface = surf, .screencentery = 40, .location = {0.5f, 1, 4} };
+	camera_update_caches(&cam);
+
+	// Front wall is highlighted, so that it gets sorted with the other wall
+	struct Rect3 rects[] = {
+		{ .corners = { {-0.5f, 1, 2}, {1.5f, 1, 2}, {1.5f, 0, 2}, {-0.5f, 0, 2} }, .highlight = true },
+		{ .corners = { {0, 1.5f, 0}, {3, 1.5f, 0}, {3, 0, 0}, {0, 0, 0} } },
+	};
+	struct Ellipsoid el = { .center = {-0.3f, 0.5f, 1}, .xzradius = 0.3f, .yradius = 0.4f, .epic = guard_get_epic() };
+	ellipsoid_update_transforms(&el);
+	struct EllipsoidSpan span = { &el, 1 };
+
+	struct ShowAllContext *ctx = showall_context_new();
+	int idx;
+	assert(showall_object_at(ctx, 0, 0, &idx) == SHOWALL_NOTHING);
+
+	showall_enable_idbuffer(ctx);
+	SDL_FillRect(surf, NULL, 0);
+	show_all(ctx, rects, 2, NULL, &span, 1, &cam);
+
+	int counts[3] = {0};
+	for (int y = 0; y < surf->h; y++) {
+		for (int x = 0; x < surf->w; x++) {
+			// Front to back
+			enum ShowAllObject expected = SHOWALL_NOTHING;
+			int expectedidx = -1;
+			if (rect_covers(&rects[0], &cam, x, y)) {
+				expected = SHOWALL_RECT;
+				expectedidx = 0;
+			} else if (ellipsoid_covers(&el, &cam, x, y)) {
+				expected = SHOWALL_ELLIPSOID;
+				expectedidx = 0;
+			} else if (rect_covers(&rects[1], &cam, x, y)) {
+				expected = SHOWALL_RECT;
+				expectedidx = 1;
+			}
+
+			idx = -1;
+			enum ShowAllObject obj = showall_object_at(ctx, x, y, &idx);
+			assert(obj == expected);
+			assert(idx == expectedidx);
+
+			uint32_t px = ((uint32_t *)surf->pixels)[y*surf->pitch/4 + x];
+			if (obj == SHOWALL_NOTHING)
+				assert(px == 0);
+			counts[obj]++;
+		}
+	}
+
+	// Everything is partly visible, and some pixels are empty
+	assert(counts[SHOWALL_NOTHING] > 0);
+	assert(counts[SHOWALL_RECT] > 0);
+	assert(counts[SHOWALL_ELLIPSOID] > 0);
+	assert(showall_object_at(ctx, -1, 0, &idx) == SHOWALL_NOTHING);
+	assert(showall_object_at(ctx, 0, surf->h, &idx) == SHOWALL_NOTHING);
+
+	showall_context_free(ctx);
+	SDL_FreeSurface(surf);
+}
+
+void test_showall_remembering_gives_same_result(void)
+{
+	SDL_Surface *surf = SDL_CreateRGBSurfaceWithFormat(0, 200, 150, 32, SDL_PIXELFORMAT_RGB888);
+	SDL_Surface *surf2 = SDL_CreateRGBSurfaceWithFormat(0, 200, 150, 32, SDL_PIXELFORMAT_RGB888);
+	assert(surf && surf2);
+	init_guard_epic();
+
+	struct Camera cam = { .surface = surf, .screencentery = 40, .location = {0.5f, 1, 4} };
+	camera_update_caches(&cam);
+	struct Camera cam2 = cam;
+	cam2.surface = surf2;
+
+	struct Rect3 rects[] = {
+		{ .corners = { {-0.5f, 1, 2}, {1.5f, 1, 2}, {1.5f, 0, 2}, {-0.5f, 0, 2} }, .highlight = true },
+		{ .corners = { {0, 1.5f, 0}, {3, 1.5f, 0}, {3, 0, 0}, {0, 0, 0} } },
+	};
+	struct Ellipsoid el = { .center = {-1, 0.5f, 1}, .xzradius = 0.3f, .yradius = 0.4f, .epic = guard_get_epic() };
+	struct EllipsoidSpan span = { &el, 1 };
+
+	// Also checks the order of drawing on each frame
+	showall_crosscheck = true;
+	struct ShowAllContext *ctx = showall_context_new();
+	showall_enable_idbuffer(ctx);
+
+	for (int frame = 0; frame < 30; frame++) {
+		// Walls and camera don't change, the ellipsoid goes behind the front wall and comes out
+		el.center.x = -1 + 0.1f*(float)frame;
+		ellipsoid_update_transforms(&el);
+
+		SDL_FillRect(surf, NULL, 0);
+		show_all(ctx, rects, 2, NULL, &span, 1, &cam);
+
+		// Same frame from scratch
+		SDL_FillRect(surf2, NULL, 0);
+		show_all(NULL, rects, 2, NULL, &span, 1, &cam2);
+		for (int y = 0; y < surf->h; y++)
+			assert(memcmp((char *)surf->pixels + y*surf->pitch, (char *)surf2->pixels + y*surf2->pitch, 4*surf->w) == 0);
+
+		// The NULL context doesn't have an id buffer, but a new context doesn't remember anything either
+		struct ShowAllContext *freshctx = showall_context_new();
+		showall_enable_idbuffer(freshctx);
+		SDL_FillRect(surf2, NULL, 0);
+		show_all(freshctx, rects, 2, NULL, &span, 1, &cam2);
+		for (int y = 0; y < surf->h; y++) {
+			for (int x = 0; x < surf->w; x++) {
+				int idx1 = -1, idx2 = -1;
+				assert(showall_object_at(ctx, x, y, &idx1) == showall_object_at(freshctx, x, y, &idx2));
+				assert(idx1 == idx2);
+			}
+		}
+		showall_context_free(freshctx);
+	}
+
+	showall_crosscheck = false;
+	showall_context_free(ctx);
+	SDL_FreeSurface(surf);
+	SDL_FreeSurface(surf2);
+}
+
+void test_showall_stack_same_as_separate_ellipsoids(void)
+{
+	SDL_Surface *surf = SDL_CreateRGBSurfaceWithFormat(0, 400, 300, 32, SDL_PIXELFORMAT_RGB888);
+	SDL_Surface *surf2 = SDL_CreateRGBSurfaceWithFormat(0, 400, 300, 32, SDL_PIXELFORMAT_RGB888);
+	assert(surf && surf2);
+	init_guard_epic();
+
+	// Looking down from above, so that the whole stack is on screen
+	struct Camera cam = { .surface = surf, .screencentery = 0, .location = {0.5f, 2.25f, 4} };
+	camera_update_caches(&cam);
+	struct Camera cam2 = cam;
+	cam2.surface = surf2;
+
+	struct Rect3 wall = { .corners = { {0, 1.5f, 1}, {3, 1.5f, 1}, {3, 0, 1}, {0, 0, 1} } };
+	struct Ellipsoid els[6];
+	for (int i = 0; i < 6; i++) {
+		els[i] = (struct Ellipsoid){
+			.center = {0.5f, 0.2f + 0.15f*(float)i, 1.5f}, .xzradius = 0.3f, .yradius = 0.2f, .epic = guard_get_epic() };
+		ellipsoid_update_transforms(&els[i]);
+	}
+
+	// Lower ellipsoids look taller from above, so they need a bigger mip level
+	int bottomlevel = ellipsoid_choose_miplevel(ellipsoid_bbox_unclipped(&els[0], &cam), cam.lodbias);
+	int toplevel = ellipsoid_choose_miplevel(ellipsoid_bbox_unclipped(&els[5], &cam), cam.lodbias);
+	assert(bottomlevel < toplevel);
+
+	struct ShowAllContext *ctx = showall_context_new();
+	struct ShowAllContext *ctx2 = showall_context_new();
+	showall_enable_idbuffer(ctx);
+	showall_enable_idbuffer(ctx2);
+
+	SDL_FillRect(surf, NULL, 0);
+	show_all(ctx, &wall, 1, NULL, &(struct EllipsoidSpan){ els, 6, true }, 1, &cam);
+	SDL_FillRect(surf2, NULL, 0);
+	show_all(ctx2, &wall, 1, NULL, &(struct EllipsoidSpan){ els, 6, false }, 1, &cam2);
+
+	int nstack = 0;
+	for (int y = 0; y < surf->h; y++) {
+		for (int x = 0; x < surf->w; x++) {
+			assert(((uint32_t *)surf->pixels)[y*surf->pitch/4 + x] == ((uint32_t *)surf2->pixels)[y*surf2->pitch/4 + x]);
+
+			// Stack has index of bottom ellipsoid
+			int idx = -1, idx2 = -1;
+			enum ShowAllObject obj = showall_object_at(ctx, x, y, &idx);
+			assert(obj == showall_object_at(ctx2, x, y, &idx2));
+			if (obj == SHOWALL_ELLIPSOID) {
+				assert(idx == 0 && 0 <= idx2 && idx2 < 6);
+				nstack++;
+			} else if (obj == SHOWALL_RECT) {
+				assert(idx == 0 && idx2 == 0);
+			}
+		}
+	}
+	assert(nstack > 100);
+
+	showall_context_free(ctx);
+	showall_context_free(ctx2);
+	SDL_FreeSurface(surf);
+	SDL_FreeSurface(surf2);
+}
@@ -0,0 +1,107 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/gamestate.h"
+#include "../src/map.h"
+#include "../src/snapshot.h"
+
+static void run_frames(struct GameState *gs, int n)
+{
+	for (int i = 0; i < n && gamestate_winner(gs) == -1; i++) {
+		// same keys every time, so that both games get the same keys
+		if (gs->thisframe % 90 == 0)
+			gamestate_handle_key(gs, SDL_SCANCODE_W, (gs->thisframe / 90) % 2 == 0);
+		if (gs->thisframe % 50 == 0)
+			gamestate_handle_key(gs, SDL_SCANCODE_LEFT, (gs->thisframe / 50) % 3 != 0);
+		gamestate_eachframe(gs);
+	}
+}
+
+void test_snapshot_continues_same_game(void)
+{
+	int nmaps;
+	struct Map *maps = map_list(&nmaps);
+	assert(nmaps > 0);
+
+	struct GameState *orig = gamestate_new(&maps[0], NULL, 2, 123, false);
+	run_frames(orig, 20*60);
+	assert(snapshot_write(orig, "snapshot_test.tmp"));
+
+	struct GameState *loaded = snapshot_load("snapshot_test.tmp", maps, nmaps);
+	remove("snapshot_test.tmp");
+	assert(loaded);
+	assert(loaded->map == orig->map);
+	assert(loaded->thisframe == orig->thisframe);
+	assert(loaded->nenemies == orig->nenemies);
+	assert(loaded->unpicked_guards.n == orig->unpicked_guards.n);
+
+	run_frames(orig, 20*60);
+	run_frames(loaded, 20*60);
+	assert(loaded->thisframe == orig->thisframe);
+	assert(loaded->nenemies == orig->nenemies);
+	for (int i = 0; i < 2; i++) {
+		assert(loaded->players[i].nguards == orig->players[i].nguards);
+		assert(memcmp(&loaded->players[i].ellipsoid.center, &orig->players[i].ellipsoid.center, sizeof(Vec3)) == 0);
+	}
+	for (int i = 0; i < orig->nenemies; i++)
+		assert(memcmp(&loaded->enemyels[i].center, &orig->enemyels[i].center, sizeof(Vec3)) == 0);
+
+	gamestate_free(orig);
+	gamestate_free(loaded);
+	free(maps);
+}
+
+// Like run_frames(), but players 2 and 3 move too
+static void run_frames_4_players(struct GameState *gs, int n)
+{
+	for (int i = 0; i < n && gamestate_winner(gs) == -1; i++) {
+		if (gs->thisframe % 70 == 0)
+			gamestate_handle_key(gs, gamestate_player_keys[2][PLAYER_KEY_MOVE], (gs->thisframe / 70) % 2 == 0);
+		if (gs->thisframe % 40 == 0)
+			gamestate_handle_key(gs, gamestate_player_keys[3][PLAYER_KEY_LEFT], (gs->thisframe / 40) % 3 != 0);
+		run_frames(gs, 1);
+	}
+}
+
+void test_snapshot_continues_same_game_4_players(void)
+{
+	int nmaps;
+	struct Map *maps = map_list(&nmaps);
+	assert(nmaps > 0);
+
+	struct GameState *orig = gamestate_new(&maps[0], NULL, 4, 123, false);
+	run_frames_4_players(orig, 20*60);
+	assert(snapshot_write(orig, "snapshot_test.tmp"));
+
+	struct GameState *loaded = snapshot_load("snapshot_test.tmp", maps, nmaps);
+	remove("snapshot_test.tmp");
+	assert(loaded);
+	assert(loaded->nplayers == 4);
+	assert(loaded->thisframe == orig->thisframe);
+
+	run_frames_4_players(orig, 20*60);
+	run_frames_4_players(loaded, 20*60);
+	assert(loaded->thisframe == orig->thisframe);
+	assert(loaded->nenemies == orig->nenemies);
+	for (int i = 0; i < 4; i++) {
+		assert(loaded->players[i].nguards == orig->players[i].nguards);
+		assert(memcmp(&loaded->players[i].ellipsoid.center, &orig->players[i].ellipsoid.center, sizeof(Vec3)) == 0);
+	}
+	for (int i = 0; i < orig->nenemies; i++)
+		assert(memcmp(&loaded->enemyels[i].center, &orig->enemyels[i].center, sizeof(Vec3)) == 0);
+
+	gamestate_free(orig);
+	gamestate_free(loaded);
+	free(maps);
+}
+
+void test_snapshot_load_errors(void)
+{
+	int nmaps;
+	struct Map *maps = map_list(&nmaps);
+	assert(snapshot_load("this file does not exist", maps, nmaps) == NULL);
+	assert(snapshot_load("README.md", maps, nmaps) == NULL);
+	free(maps);
+}
@@ -0,0 +1,64 @@
+#include <assert.h>
+#include <math.h>
+#include "../src/ellipsoid.h"
+#include "../src/linalg.h"
+#include "../src/player.h"
+#include "../src/wall.h"
+
+// Smallest distance from center of ellipsoid to wall, in coordinates where ellipsoid is unit ball
+static float uball_distance_to_wall(const struct Ellipsoid *el, const struct Wall *w)
+{
+	Vec3 center = mat3_mul_vec3(el->world2uball, el->center);
+	float best = HUGE_VALF;
+
+	// lots of points, more than the game ever used
+	for (int i = 0; i <= 100; i++) {
+		for (int k = 0; k <= 100; k++) {
+			Vec3 p = { w->startx, PLAYER_HEIGHT_FLAT + (1 - PLAYER_HEIGHT_FLAT)*k/100.0f, w->startz };
+			if (w->dir == WALL_DIR_XY)
+				p.x += i/100.0f;
+			else
+				p.z += i/100.0f;
+			best = fminf(best, sqrtf(vec3_lengthSQUARED(vec3_sub(center, mat3_mul_vec3(el->world2uball, p)))));
+		}
+	}
+	return best;
+}
+
+void test_wall_bumps_ellipsoid_just_enough(void)
+{
+	struct Wall walls[] = {
+		{ .startx = 2, .startz = 3, .dir = WALL_DIR_XY },
+		{ .startx = 2, .startz = 3, .dir = WALL_DIR_ZY },
+	};
+
+	for (int w = 0; w < 2; w++) {
+		// ellipsoid centers at middle of wall, near ends, beyond ends, above and below
+		for (float along = -0.3f; along < 1.35f; along += 0.1f) {
+			for (float y = 0.2f; y < 1.8f; y += 0.2f) {
+				Vec3 start = { 2, y, 3.2f };
+				if (walls[w].dir == WALL_DIR_XY)
+					start.x += along;
+				else
+					start = (Vec3){ 2.2f, y, 3 + along };
+
+				struct Ellipsoid el = { .center = start, .angle = 1, .xzradius = PLAYER_XZRADIUS, .yradius = 0.5f };
+				ellipsoid_update_transforms(&el);
+				float before = uball_distance_to_wall(&el, &walls[w]);
+
+				wall_bumps_ellipsoid(&walls[w], &el);
+				float after = uball_distance_to_wall(&el, &walls[w]);
+
+				assert(el.center.y == start.y);   // doesn't move up or down
+				if (before >= 1.02f) {
+					assert(el.center.x == start.x && el.center.z == start.z);
+				} else {
+					// must not go through the wall
+					assert(wall_side(&walls[w], el.center) == wall_side(&walls[w], start));
+					assert(after > 0.99f);
+					assert(after < 1.03f);   // doesn't move too much, but wall is approximated with points here
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,83 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "../src/camera.h"
+#include "../src/max.h"
+#include "../src/prng.h"
+#include "../src/rect3.h"
+#include "../src/wall.h"
+#include "../src/wallgrid.h"
+
+static struct Wall random_wall(struct Prng *prng)
+{
+	return (struct Wall){
+		.startx = prng_int(prng, MAX_MAPSIZE),
+		.startz = prng_int(prng, MAX_MAPSIZE),
+		.dir = prng_int(prng, 2) ? WALL_DIR_XY : WALL_DIR_ZY,
+	};
+}
+
+static void check_grid(const struct WallGrid *grid, const struct Rect3 *rects, int nrects, struct Prng *prng)
+{
+	SDL_Surface surf = { .w = 400, .h = 300 };
+	static bool maybevisible[MAX_WALLS];
+
+	for (int c = 0; c < 20; c++) {
+		struct Camera cam = {
+			.surface = &surf,
+			.screencentery = 75,
+			.location = { (float)prng_int(prng, MAX_MAPSIZE), 4, (float)prng_int(prng, MAX_MAPSIZE) },
+			.angle = (float)prng_int(prng, 628) / 100,
+		};
+		camera_update_caches(&cam);
+		wallgrid_find_maybe_visible(grid, &cam, maybevisible);
+
+		for (int i = 0; i < nrects; i++) {
+			struct Rect3Cache cache;
+			if (rect3_visible_fillcache(&rects[i], &cam, &cache))
+				assert(maybevisible[i]);
+		}
+	}
+}
+
+void test_wallgrid_finds_all_visible_walls(void)
+{
+	struct Prng prng;
+	prng_seed(&prng, 2);
+
+	struct WallGrid *grid = calloc(1, sizeof(*grid));
+	static struct Rect3 rects[MAX_WALLS];
+	int nrects = 300;
+	for (int i = 0; i < nrects; i++) {
+		struct Wall w = random_wall(&prng);
+		rects[i] = wall_to_rect3(&w);
+	}
+	wallgrid_update(grid, rects, nrects);
+	check_grid(grid, rects, nrects, &prng);
+
+	// Change some walls, delete some walls, like in the map editor
+	for (int i = 0; i < 50; i++) {
+		struct Wall w = random_wall(&prng);
+		rects[prng_int(&prng, nrects)] = wall_to_rect3(&w);
+	}
+	nrects -= 100;
+	wallgrid_update(grid, rects, nrects);
+	check_grid(grid, rects, nrects, &prng);
+
+	// Updating must give the same chunks as starting from scratch
+	struct WallGrid *fresh = calloc(1, sizeof(*fresh));
+	wallgrid_update(fresh, rects, nrects);
+	for (int x = 0; x < WALLGRID_NCHUNKS; x++) {
+		for (int z = 0; z < WALLGRID_NCHUNKS; z++) {
+			int count1 = 0, count2 = 0;
+			for (int i = grid->chunks[x][z].first - 1; i != -1; i = grid->next[i] - 1)
+				count1++;
+			for (int i = fresh->chunks[x][z].first - 1; i != -1; i = fresh->next[i] - 1)
+				count2++;
+			assert(count1 == count2);
+		}
+	}
+
+	free(grid);
+	free(fresh);
+}